@@ -0,0 +1,128 @@
+#include <cstdlib>
+#include <new>
+#include "AllocationCounter.h"
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// Replacement global operator new / delete for AllocationCounter, the whole set so every form is counted
+// and every allocation is freed by its matching function
+// Kept in its own file so the compiler never inlines a delete next to the new it frees
+// Counting only happens between AllocationCounter::start and stop, which only --task-bench calls
+
+static void* counted_allocate(std::size_t size) noexcept {
+    AllocationCounter::record();
+    return std::malloc(size ? size : 1);
+}
+
+static void* counted_allocate(std::size_t size, std::align_val_t alignment) noexcept {
+    AllocationCounter::record();
+    const std::size_t align = static_cast<std::size_t>(alignment);
+#ifdef _WIN32
+    return _aligned_malloc(size ? size : 1, align);
+#else
+    // aligned_alloc wants a whole number of alignments
+    return std::aligned_alloc(align, ((size ? size : 1) + align - 1) / align * align);
+#endif
+}
+
+static void counted_free(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+static void counted_free(void* ptr, std::align_val_t) noexcept {
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+
+void* operator new(std::size_t size) {
+    if (void* ptr = counted_allocate(size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    if (void* ptr = counted_allocate(size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return counted_allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return counted_allocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    if (void* ptr = counted_allocate(size, alignment))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    if (void* ptr = counted_allocate(size, alignment))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return counted_allocate(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return counted_allocate(size, alignment);
+}
+
+void operator delete(void* ptr) noexcept {
+    counted_free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    counted_free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    counted_free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    counted_free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+    counted_free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+    counted_free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t alignment) noexcept {
+    counted_free(ptr, alignment);
+}
+
+void operator delete[](void* ptr, std::align_val_t alignment) noexcept {
+    counted_free(ptr, alignment);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t alignment) noexcept {
+    counted_free(ptr, alignment);
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t alignment) noexcept {
+    counted_free(ptr, alignment);
+}
+
+void operator delete(void* ptr, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    counted_free(ptr, alignment);
+}
+
+void operator delete[](void* ptr, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    counted_free(ptr, alignment);
+}
@@ -0,0 +1,30 @@
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <atomic>
+#include <cstddef>
+
+// Counts calls to the global operator new while enabled, used to prove the hot paths do not allocate
+// The replacement operator new / delete set that calls record() is in AllocationCounter.cpp
+namespace AllocationCounter {
+    inline std::atomic<bool> enabled{ false };
+    inline std::atomic<size_t> allocations{ 0 };
+
+    inline void record() {
+        if (enabled.load(std::memory_order_relaxed))
+            allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    inline void start() {
+        allocations.store(0);
+        enabled.store(true);
+    }
+
+    // Stop counting and return how many allocations were seen
+    inline size_t stop() {
+        enabled.store(false);
+        return allocations.load();
+    }
+}
+
+#endif // ALLOCATION_COUNTER_H
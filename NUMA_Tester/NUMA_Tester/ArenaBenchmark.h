@@ -0,0 +1,100 @@
+#ifndef ARENA_BENCHMARK_H
+#define ARENA_BENCHMARK_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "Constants.h"
+#include "MemoryAllocator.h"
+#include "PerfCounter.h"
+#include "Platform.h"
+#include "Topology.h"
+
+// Builds a Node pool with each page backend and reports, run with --arena-bench
+//   construction time (map + parallel prefault + carve)
+//   a sequential sweep writing every Frame, with dTLB store misses
+//   random cache line reads over the whole pool, with dTLB load misses
+// The sweeps run on one thread pinned to the Node so the counters belong to a single thread
+class ArenaBenchmark {
+public:
+    // allocator_options gives the pool and Frame size, its backend and interleave set are ignored as every backend is tried on the one Node
+    ArenaBenchmark(const Topology& topology, size_t node_index = 0, const AllocatorOptions& allocator_options = {})
+        : topology(topology), node_index(node_index), allocator_options(allocator_options) {
+    }
+
+    void run() {
+        const NodeInfo& node = topology.get_nodes()[node_index];
+        Platform::pin_current_thread(node.cpus);
+
+        std::cout << "Arena backends on Node " << node.id << " (" << allocator_options.pool_size / (1024 * 1024) << " MB pool)\n";
+        std::cout << std::setw(10) << "Asked" << std::setw(10) << "Got" << std::setw(14) << "Construct s"
+            << std::setw(12) << "Sweep s" << std::setw(16) << "dTLB st miss"
+            << std::setw(12) << "Random s" << std::setw(16) << "dTLB ld miss" << "\n";
+
+        for (auto backend : { Platform::PageBackend::Default, Platform::PageBackend::Transparent,
+            Platform::PageBackend::Huge2MB, Platform::PageBackend::Huge1GB }) {
+            AllocatorOptions options = allocator_options;
+            options.interleave_nodes.clear();
+            options.backend = backend;
+            MemoryAllocator allocator(node.id, node.cpus, options);
+
+            PerfCounter store_misses(PerfCounter::TYPE_HW_CACHE, PerfCounter::DTLB_STORE_MISSES);
+            auto start = std::chrono::high_resolution_clock::now();
+            store_misses.start();
+            for (std::byte* frame : allocator.getFrames())
+                std::fill(frame, frame + allocator.get_frame_size(), std::byte{ 0xAA });
+            store_misses.stop();
+            std::chrono::duration<double> sweep = std::chrono::high_resolution_clock::now() - start;
+
+            PerfCounter load_misses(PerfCounter::TYPE_HW_CACHE, PerfCounter::DTLB_LOAD_MISSES);
+            start = std::chrono::high_resolution_clock::now();
+            load_misses.start();
+            sink = random_reads(allocator);
+            load_misses.stop();
+            std::chrono::duration<double> random = std::chrono::high_resolution_clock::now() - start;
+
+            std::cout << std::setw(10) << Platform::page_backend_name(backend)
+                << std::setw(10) << Platform::page_backend_name(allocator.get_backend())
+                << std::fixed << std::setprecision(3)
+                << std::setw(14) << allocator.get_construction_seconds()
+                << std::setw(12) << sweep.count() << std::setw(16) << counter_text(store_misses)
+                << std::setw(12) << random.count() << std::setw(16) << counter_text(load_misses) << std::endl;
+        }
+    }
+
+private:
+    static constexpr size_t RANDOM_READS = 16 * 1024 * 1024;
+
+    const Topology& topology;
+    size_t node_index;
+    AllocatorOptions allocator_options;
+    volatile uint64_t sink = 0;     // Keeps the random reads from being optimized away
+
+    static std::string counter_text(const PerfCounter& counter) {
+        return counter.valid() ? std::to_string(counter.read()) : "n/a";
+    }
+
+    // Independent random loads across every Frame, each one a likely TLB miss with base pages
+    static uint64_t random_reads(const MemoryAllocator& allocator) {
+        const auto& frames = allocator.getFrames();
+        if (frames.empty())
+            return 0;
+        const size_t lines_per_frame = std::max<size_t>(1, allocator.get_frame_size() / CACHE_LINE_SIZE);
+        uint64_t state = 0x9E3779B97F4A7C15ULL;
+        uint64_t sum = 0;
+        for (size_t i = 0; i < RANDOM_READS; ++i) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            const std::byte* frame = frames[state % frames.size()];
+            sum += static_cast<uint64_t>(frame[((state >> 20) % lines_per_frame) * CACHE_LINE_SIZE]);
+        }
+        return sum;
+    }
+};
+
+#endif // ARENA_BENCHMARK_H
@@ -0,0 +1,189 @@
+#ifndef BENCHMARK_HARNESS_H
+#define BENCHMARK_HARNESS_H
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BenchmarkReport.h"
+#include "FrameKernels.h"
+#include "NodeManager.h"
+#include "PerfCapture.h"
+#include "Telemetry.h"
+
+struct BenchmarkOptions {
+    size_t loops = 10;                      // Passes over every Frame in one run of a Scenario
+    size_t repetitions = 5;                 // Timed runs per kernel and Scenario
+    size_t warmup = 1;                      // Untimed runs before them
+    double sleep_seconds = 0.0;             // Pause after each Scenario so a profiler can tell them apart
+    std::vector<std::string> scenarios;     // Scenario names to run, empty runs all of them
+    bool together = false;                  // Run the selected Scenarios at the same time, as one combined Scenario
+    std::vector<std::string> kernels = { "fill" };
+    Isa max_isa = Isa::AVX512;
+    bool telemetry = false;                 // Print the ThreadPool latency histograms of the timed runs
+    bool perf = false;                      // Count hardware events on every pool thread during the timed runs
+};
+
+// Runs every selected kernel over every selected Scenario of a NodeManager, warmup first,
+// and prints one line of statistics per pair as it goes
+class BenchmarkHarness {
+public:
+    BenchmarkHarness(NodeManager& node_manager, const BenchmarkOptions& options)
+        : node_manager(node_manager), options(options) {
+    }
+
+    // Check the kernel and Scenario names before anything runs, prints the unknown ones
+    bool validate(std::ostream& os) const {
+        bool valid = true;
+        for (const auto& name : options.kernels) {
+            if (!KernelRegistry::instance().find(name, options.max_isa)) {
+                os << "Unknown kernel: " << name << ", --kernels lists them" << std::endl;
+                valid = false;
+            }
+        }
+        const auto scenarios = node_manager.get_scenarios();
+        for (const auto& name : options.scenarios) {
+            if (std::none_of(scenarios.begin(), scenarios.end(), [&name](const Scenario& scenario) { return scenario.name == name; })) {
+                os << "Unknown scenario: " << name << ", --list-scenarios lists them" << std::endl;
+                valid = false;
+            }
+        }
+        return valid;
+    }
+
+    std::vector<ScenarioStats> run() {
+        std::vector<Scenario> scenarios = node_manager.get_scenarios();
+        if (!options.scenarios.empty()) {
+            std::erase_if(scenarios, [this](const Scenario& scenario) {
+                return std::find(options.scenarios.begin(), options.scenarios.end(), scenario.name) == options.scenarios.end();
+                });
+        }
+        if (options.together && scenarios.size() > 1)
+            scenarios = { ScenarioEngine::combine(scenarios) };
+
+        std::cout << std::setw(12) << "Kernel" << std::setw(8) << "ISA" << std::setw(16) << "Scenario"
+            << std::setw(12) << "Median s" << std::setw(12) << "Min s" << std::setw(12) << "P95 s"
+            << std::setw(12) << "Stddev s" << std::setw(10) << "GB/s" << "\n";
+
+        std::unique_ptr<PerfCapture> perf;
+        if (options.perf) {
+            perf = std::make_unique<PerfCapture>(node_manager.get_thread_ids());
+            if (!perf->available()) {
+                std::cout << "perf: no hardware counters available (no PMU, perf_event_paranoid or not Linux), continuing without them" << std::endl;
+                perf.reset();
+            }
+            else {
+                std::cout << "perf: counting";
+                for (size_t event = 0; event < PERF_EVENT_COUNT; ++event)
+                    std::cout << " " << scenario_events()[event].name << (perf->available(event) ? "" : " (n/a)");
+                std::cout << std::endl;
+            }
+        }
+
+        std::vector<ScenarioStats> results;
+        for (const auto& name : options.kernels) {
+            const auto* kernel = KernelRegistry::instance().find(name, options.max_isa);
+            node_manager.set_kernel(kernel->kernel);
+
+            for (const Scenario& scenario : scenarios) {
+                for (size_t i = 0; i < options.warmup; ++i)
+                    node_manager.run_scenario(scenario, options.loops);
+
+                const auto telemetry_before = node_manager.get_telemetry();
+                if (perf)
+                    perf->start();
+                std::vector<double> samples;
+                uint64_t bytes = 0;
+                for (size_t i = 0; i < options.repetitions; ++i) {
+                    ScenarioTiming timing = node_manager.run_scenario(scenario, options.loops);
+                    samples.push_back(timing.seconds);
+                    bytes = timing.bytes;
+                }
+                if (perf)
+                    perf->stop();
+
+                ScenarioStats stats = BenchmarkReport::summarize(samples, bytes);
+                stats.kernel = kernel->name;
+                stats.isa = isa_name(kernel->isa);
+                stats.scenario = scenario.name;
+                if (perf) {
+                    stats.threads = perf->read();
+                    for (auto& thread : stats.threads) {
+                        for (int64_t& value : thread.values)
+                            value = value < 0 ? value : value / static_cast<int64_t>(options.repetitions);
+                    }
+                    stats.counters = PerfCapture::total(stats.threads);
+                }
+                print(stats);
+                if (perf)
+                    print_counters(stats);
+                results.push_back(stats);
+                if (options.telemetry)
+                    print_telemetry(telemetry_before, node_manager.get_telemetry());
+
+                if (options.sleep_seconds > 0.0)
+                    std::this_thread::sleep_for(std::chrono::duration<double>(options.sleep_seconds));
+            }
+        }
+        return results;
+    }
+
+private:
+    NodeManager& node_manager;
+    BenchmarkOptions options;
+
+    static void print(const ScenarioStats& stats) {
+        std::cout << std::setw(12) << stats.kernel << std::setw(8) << stats.isa << std::setw(16) << stats.scenario
+            << std::fixed << std::setprecision(4)
+            << std::setw(12) << stats.median << std::setw(12) << stats.min << std::setw(12) << stats.p95
+            << std::setw(12) << stats.stddev << std::setprecision(2) << std::setw(10) << stats.gbps << std::endl;
+    }
+
+    // Derived numbers per repetition: IPC, LLC misses per MB of Frames, share of DRAM loads that went remote
+    static void print_counters(const ScenarioStats& stats) {
+        const PerfValues& v = stats.counters;
+        auto text = [](int64_t value) { return value < 0 ? std::string("n/a") : std::to_string(value); };
+        std::cout << "        perf  cycles " << text(v[0]) << "  instructions " << text(v[1]) << std::fixed << std::setprecision(2);
+        if (v[0] > 0 && v[1] >= 0)
+            std::cout << " (IPC " << static_cast<double>(v[1]) / v[0] << ")";
+        std::cout << "  llc misses " << text(v[2]);
+        if (v[2] >= 0 && stats.bytes)
+            std::cout << " (" << v[2] / (stats.bytes / 1048576.0) << "/MB)";
+        std::cout << "  dram local " << text(v[3]) << " remote " << text(v[4]);
+        if (v[3] >= 0 && v[4] >= 0 && v[3] + v[4] > 0)
+            std::cout << " (" << 100.0 * v[4] / (v[3] + v[4]) << "% remote)";
+        std::cout << "  dtlb ld " << text(v[5]) << " st " << text(v[6]) << std::endl;
+    }
+
+    // Per Frame (parallel_for chunk) wait and run time percentiles of the timed runs, then each pool's utilization
+    static void print_telemetry(const std::vector<Telemetry::PoolSnapshot>& before, const std::vector<Telemetry::PoolSnapshot>& after) {
+        if (!Telemetry::ENABLED) {
+            std::cout << "        telemetry: built with THREAD_POOL_TELEMETRY=0" << std::endl;
+            return;
+        }
+        Telemetry::WorkerSnapshot total;
+        std::vector<Telemetry::WorkerSnapshot> pools;
+        for (size_t i = 0; i < after.size(); ++i) {
+            pools.push_back(after[i].since(before[i]).total());
+            total += pools.back();
+        }
+
+        auto us = [](uint64_t ns) { return ns / 1000.0; };
+        std::cout << std::fixed << std::setprecision(1)
+            << "        frames " << total.items
+            << "  wait us p50 " << us(total.item_wait.percentile(0.50)) << " p99 " << us(total.item_wait.percentile(0.99))
+            << " p99.9 " << us(total.item_wait.percentile(0.999)) << " max " << us(total.item_wait.max())
+            << "  run us p50 " << us(total.item_run.percentile(0.50)) << " p99 " << us(total.item_run.percentile(0.99))
+            << " max " << us(total.item_run.max())
+            << "  wakeup us p99 " << us(total.wakeup.percentile(0.99)) << "\n";
+        std::cout << "        utilization";
+        for (size_t i = 0; i < pools.size(); ++i)
+            std::cout << "  pool " << i << " " << pools[i].utilization() * 100 << "%";
+        std::cout << "  steals " << total.steals << " remote " << total.remote_steals << std::endl;
+    }
+};
+
+#endif // BENCHMARK_HARNESS_H
@@ -0,0 +1,252 @@
+#ifndef BENCHMARK_REPORT_H
+#define BENCHMARK_REPORT_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "PerfCapture.h"
+
+// Summary of the timed repetitions of one kernel on one Scenario, times in seconds
+struct ScenarioStats {
+    std::string kernel;
+    std::string isa;
+    std::string scenario;
+    size_t samples = 0;
+    double median = 0.0;
+    double min = 0.0;
+    double p95 = 0.0;
+    double stddev = 0.0;
+    uint64_t bytes = 0;     // Frame bytes put through the kernel per repetition
+    double gbps = 0.0;      // bytes / median
+    PerfValues counters = no_perf_values();     // Per repetition, summed over the pool threads (--perf)
+    std::vector<ThreadCounters> threads;        // Per repetition, each pool thread on its own (--perf)
+};
+
+// What the results were measured on, written at the top of the JSON report
+struct RunInfo {
+    std::string host;
+    std::string cpu_isa;
+    std::string pool_mode;
+    std::string pages;
+    size_t nodes = 0;
+    size_t cpus = 0;
+    size_t pool_size = 0;
+    size_t frame_size = 0;
+    size_t loops = 0;
+    size_t repetitions = 0;
+    size_t warmup = 0;
+};
+
+// Statistics and the JSON / CSV files for the benchmark harness
+// The CSV doubles as the baseline format, --baseline reads back a file --csv wrote
+namespace BenchmarkReport {
+
+    // Median, min, nearest rank p95 and sample standard deviation of the repetitions
+    inline ScenarioStats summarize(std::vector<double> samples, uint64_t bytes) {
+        ScenarioStats stats;
+        stats.samples = samples.size();
+        stats.bytes = bytes;
+        if (samples.empty())
+            return stats;
+
+        std::sort(samples.begin(), samples.end());
+        const size_t n = samples.size();
+        stats.min = samples.front();
+        stats.median = n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+        stats.p95 = samples[static_cast<size_t>(std::ceil(0.95 * n)) - 1];
+
+        double mean = 0.0;
+        for (double sample : samples)
+            mean += sample;
+        mean /= n;
+        double variance = 0.0;
+        for (double sample : samples)
+            variance += (sample - mean) * (sample - mean);
+        stats.stddev = n > 1 ? std::sqrt(variance / (n - 1)) : 0.0;
+
+        stats.gbps = stats.median > 0.0 ? bytes / stats.median / 1e9 : 0.0;
+        return stats;
+    }
+
+    inline std::string json_string(const std::string& text) {
+        std::string quoted = "\"";
+        for (char c : text) {
+            if (c == '"' || c == '\\')
+                quoted += '\\';
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+
+    // Counter values as a JSON object, null where the event was not captured
+    inline void write_json_counters(std::ostream& out, const PerfValues& values) {
+        out << "{";
+        for (size_t event = 0; event < PERF_EVENT_COUNT; ++event) {
+            out << (event ? ", \"" : " \"") << scenario_events()[event].name << "\": ";
+            if (values[event] < 0)
+                out << "null";
+            else
+                out << values[event];
+        }
+        out << " }";
+    }
+
+    inline bool write_json(const std::string& path, const RunInfo& info, const std::vector<ScenarioStats>& results) {
+        std::ofstream out(path);
+        if (!out)
+            return false;
+        out << std::setprecision(9);
+        out << "{\n  \"run\": {\n"
+            << "    \"host\": " << json_string(info.host) << ",\n"
+            << "    \"cpu_isa\": " << json_string(info.cpu_isa) << ",\n"
+            << "    \"pool_mode\": " << json_string(info.pool_mode) << ",\n"
+            << "    \"pages\": " << json_string(info.pages) << ",\n"
+            << "    \"nodes\": " << info.nodes << ",\n"
+            << "    \"cpus\": " << info.cpus << ",\n"
+            << "    \"pool_size\": " << info.pool_size << ",\n"
+            << "    \"frame_size\": " << info.frame_size << ",\n"
+            << "    \"loops\": " << info.loops << ",\n"
+            << "    \"repetitions\": " << info.repetitions << ",\n"
+            << "    \"warmup\": " << info.warmup << "\n"
+            << "  },\n  \"results\": [";
+        for (size_t i = 0; i < results.size(); ++i) {
+            const ScenarioStats& stats = results[i];
+            out << (i ? ",\n" : "\n")
+                << "    { \"kernel\": " << json_string(stats.kernel)
+                << ", \"isa\": " << json_string(stats.isa)
+                << ", \"scenario\": " << json_string(stats.scenario)
+                << ", \"samples\": " << stats.samples
+                << ", \"median_s\": " << stats.median
+                << ", \"min_s\": " << stats.min
+                << ", \"p95_s\": " << stats.p95
+                << ", \"stddev_s\": " << stats.stddev
+                << ", \"bytes\": " << stats.bytes
+                << ", \"gbps\": " << stats.gbps;
+            if (!stats.threads.empty()) {
+                out << ",\n      \"counters\": ";
+                write_json_counters(out, stats.counters);
+                out << ",\n      \"threads\": [";
+                for (size_t t = 0; t < stats.threads.size(); ++t) {
+                    const ThreadCounters& thread = stats.threads[t];
+                    out << (t ? ",\n" : "\n") << "        { \"node\": " << thread.node << ", \"thread\": " << thread.thread
+                        << ", \"tid\": " << thread.tid << ", \"counters\": ";
+                    write_json_counters(out, thread.values);
+                    out << " }";
+                }
+                out << "\n      ]\n    ";
+            }
+            out << " }";
+        }
+        out << "\n  ]\n}\n";
+        return static_cast<bool>(out);
+    }
+
+    inline bool write_csv(const std::string& path, const std::vector<ScenarioStats>& results) {
+        std::ofstream out(path);
+        if (!out)
+            return false;
+        out << std::setprecision(9);
+        out << "kernel,isa,scenario,samples,median_s,min_s,p95_s,stddev_s,bytes,gbps";
+        for (const PerfEvent& event : scenario_events())
+            out << ',' << event.name;
+        out << '\n';
+        for (const ScenarioStats& stats : results) {
+            out << stats.kernel << ',' << stats.isa << ',' << stats.scenario << ',' << stats.samples << ','
+                << stats.median << ',' << stats.min << ',' << stats.p95 << ',' << stats.stddev << ','
+                << stats.bytes << ',' << stats.gbps;
+            // Empty where the counter was not captured
+            for (int64_t value : stats.counters) {
+                out << ',';
+                if (value >= 0)
+                    out << value;
+            }
+            out << '\n';
+        }
+        return static_cast<bool>(out);
+    }
+
+    // Read a file written by write_csv, false if it can not be opened or a row does not parse
+    // Files from before the counter columns were added still load
+    inline bool read_csv(const std::string& path, std::vector<ScenarioStats>& results) {
+        std::ifstream in(path);
+        if (!in)
+            return false;
+        std::string line;
+        std::getline(in, line);     // Header
+        while (std::getline(in, line)) {
+            if (line.empty())
+                continue;
+            std::vector<std::string> fields;
+            std::stringstream row(line);
+            std::string field;
+            while (std::getline(row, field, ','))
+                fields.push_back(field);
+            if (!line.empty() && line.back() == ',')
+                fields.push_back("");   // getline drops a trailing empty field
+            if (fields.size() != 10 && fields.size() != 10 + PERF_EVENT_COUNT)
+                return false;
+            try {
+                ScenarioStats stats;
+                stats.kernel = fields[0];
+                stats.isa = fields[1];
+                stats.scenario = fields[2];
+                stats.samples = std::stoull(fields[3]);
+                stats.median = std::stod(fields[4]);
+                stats.min = std::stod(fields[5]);
+                stats.p95 = std::stod(fields[6]);
+                stats.stddev = std::stod(fields[7]);
+                stats.bytes = std::stoull(fields[8]);
+                stats.gbps = std::stod(fields[9]);
+                for (size_t event = 0; fields.size() > 10 && event < PERF_EVENT_COUNT; ++event)
+                    stats.counters[event] = fields[10 + event].empty() ? -1 : std::stoll(fields[10 + event]);
+                results.push_back(stats);
+            }
+            catch (const std::exception&) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Compare median GB/s with the baseline entry of the same kernel and Scenario
+    // Slower by more than tolerance (0.1 = 10%) is a regression, returns false if there was any
+    // Entries missing on either side are listed but do not fail the run
+    inline bool compare(const std::vector<ScenarioStats>& results, const std::vector<ScenarioStats>& baseline,
+        double tolerance, std::ostream& os) {
+        bool passed = true;
+        os << "Baseline comparison (median GB/s, tolerance " << tolerance * 100 << "%)\n";
+        for (const ScenarioStats& stats : results) {
+            auto match = std::find_if(baseline.begin(), baseline.end(), [&stats](const ScenarioStats& base) {
+                return base.kernel == stats.kernel && base.scenario == stats.scenario;
+                });
+            os << std::setw(12) << stats.kernel << std::setw(16) << stats.scenario;
+            if (match == baseline.end()) {
+                os << "  not in baseline\n";
+                continue;
+            }
+            const double change = match->gbps > 0.0 ? stats.gbps / match->gbps - 1.0 : 0.0;
+            const bool regressed = change < -tolerance;
+            passed = passed && !regressed;
+            os << std::fixed << std::setprecision(2) << std::setw(10) << match->gbps << " -> " << std::setw(8) << stats.gbps
+                << std::showpos << std::setw(9) << change * 100 << "%" << std::noshowpos
+                << (regressed ? "  REGRESSION" : "") << (match->isa != stats.isa ? "  (isa " + match->isa + ")" : "") << "\n";
+        }
+        for (const ScenarioStats& base : baseline) {
+            bool found = std::any_of(results.begin(), results.end(), [&base](const ScenarioStats& stats) {
+                return base.kernel == stats.kernel && base.scenario == stats.scenario;
+                });
+            if (!found)
+                os << std::setw(12) << base.kernel << std::setw(16) << base.scenario << "  not run\n";
+        }
+        os << (passed ? "Baseline: PASS" : "Baseline: FAIL") << std::endl;
+        return passed;
+    }
+}
+
+#endif // BENCHMARK_REPORT_H
@@ -4,7 +4,9 @@
 #include <cstdint>
 
 // Some fixed parameters, these could be Cmd Line Params
-constexpr uint64_t FRAME_SIZE = 1920 * 1080 * 3; // Example frame size for 1080p RGB video
+constexpr size_t FRAME_WIDTH = 1920;
+constexpr size_t FRAME_HEIGHT = 1080;
+constexpr uint64_t FRAME_SIZE = FRAME_WIDTH * FRAME_HEIGHT * 3; // Example frame size for 1080p RGB video
 constexpr size_t CACHE_LINE_SIZE = 64; // Typical cache line size
 constexpr uint64_t POOL_SIZE = 10ULL * 1024ULL * 1024ULL * 1024ULL; // 10GB pool size
 
@@ -0,0 +1,325 @@
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+template <class T>
+class CoTask;
+
+namespace CoroutineDetail {
+    // Resumes whoever awaited the task once it is done, by symmetric transfer so deep chains do not grow the stack
+    struct FinalAwaiter {
+        bool await_ready() const noexcept {
+            return false;
+        }
+
+        template <class Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            return handle.promise().continuation;
+        }
+
+        void await_resume() const noexcept {
+        }
+    };
+
+    struct PromiseBase {
+        std::coroutine_handle<> continuation = std::noop_coroutine();
+        std::exception_ptr error;
+
+        // Lazy: nothing runs until the task is awaited
+        std::suspend_always initial_suspend() const noexcept {
+            return {};
+        }
+
+        FinalAwaiter final_suspend() const noexcept {
+            return {};
+        }
+
+        void unhandled_exception() {
+            error = std::current_exception();
+        }
+    };
+
+    template <class T>
+    struct Promise : PromiseBase {
+        std::optional<T> value;
+
+        CoTask<T> get_return_object();
+
+        template <class U>
+        void return_value(U&& result) {
+            value.emplace(std::forward<U>(result));
+        }
+
+        T result() {
+            if (error)
+                std::rethrow_exception(error);
+            return std::move(*value);
+        }
+    };
+
+    template <>
+    struct Promise<void> : PromiseBase {
+        CoTask<void> get_return_object();
+
+        void return_void() const noexcept {
+        }
+
+        void result() const {
+            if (error)
+                std::rethrow_exception(error);
+        }
+    };
+
+    // Start a task and come back when it is done, without taking its result
+    template <class T>
+    struct Completion {
+        std::coroutine_handle<Promise<T>> task;
+
+        bool await_ready() const noexcept {
+            return !task || task.done();
+        }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+            task.promise().continuation = awaiting;
+            return task;
+        }
+
+        void await_resume() const noexcept {
+        }
+    };
+
+    // The caller of sync_wait sleeps on this, set under the lock so the caller can not return and free it
+    // while the setting thread is still inside
+    struct Signal {
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool done = false;
+
+        void set() {
+            std::lock_guard<std::mutex> lock(mutex);
+            done = true;
+            condition.notify_all();
+        }
+
+        void wait() {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return done; });
+        }
+    };
+
+    // Shared by the children of one when_all, the last to finish resumes the parent
+    struct WhenAllState {
+        std::atomic<size_t> remaining{ 0 };
+        std::coroutine_handle<> parent;
+    };
+
+    // Eagerly started coroutine that runs one task to completion and then reports to a Signal or a WhenAllState
+    // Never throws, the task it awaits keeps any exception for its owner
+    struct Driver {
+        struct promise_type {
+            Signal* signal = nullptr;
+            WhenAllState* state = nullptr;
+
+            Driver get_return_object() {
+                return Driver{ std::coroutine_handle<promise_type>::from_promise(*this) };
+            }
+
+            std::suspend_always initial_suspend() const noexcept {
+                return {};
+            }
+
+            struct Report {
+                bool await_ready() const noexcept {
+                    return false;
+                }
+
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                    promise_type& promise = handle.promise();
+                    if (promise.signal) {
+                        promise.signal->set();
+                        return std::noop_coroutine();
+                    }
+                    if (promise.state->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                        return promise.state->parent;
+                    return std::noop_coroutine();
+                }
+
+                void await_resume() const noexcept {
+                }
+            };
+
+            Report final_suspend() const noexcept {
+                return {};
+            }
+
+            void return_void() const noexcept {
+            }
+
+            void unhandled_exception() const noexcept {
+                std::terminate();
+            }
+        };
+
+        explicit Driver(std::coroutine_handle<promise_type> handle) : handle(handle) {
+        }
+
+        Driver(Driver&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {
+        }
+
+        Driver(const Driver&) = delete;
+        Driver& operator=(const Driver&) = delete;
+
+        ~Driver() {
+            if (handle)
+                handle.destroy();
+        }
+
+        std::coroutine_handle<promise_type> handle;
+    };
+
+    template <class T>
+    Driver drive(std::coroutine_handle<Promise<T>> task) {
+        co_await Completion<T>{ task };
+    }
+
+    // Starts every child and suspends the parent until the last one is done, or not at all if they all finished inline
+    template <class T>
+    struct WhenAllAwaiter {
+        explicit WhenAllAwaiter(std::vector<CoTask<T>>& tasks) : tasks(tasks) {
+        }
+
+        std::vector<CoTask<T>>& tasks;
+        WhenAllState state;
+        std::vector<Driver> drivers;
+
+        bool await_ready() const noexcept {
+            return tasks.empty();
+        }
+
+        bool await_suspend(std::coroutine_handle<> parent) {
+            state.parent = parent;
+            state.remaining.store(tasks.size() + 1, std::memory_order_relaxed);
+            drivers.reserve(tasks.size());
+            for (auto& task : tasks) {
+                drivers.push_back(drive<T>(task.handle));
+                drivers.back().handle.promise().state = &state;
+            }
+            for (auto& driver : drivers)
+                driver.handle.resume();
+            // The extra count is ours, dropping it last means the parent is resumed exactly once
+            return state.remaining.fetch_sub(1, std::memory_order_acq_rel) != 1;
+        }
+
+        void await_resume() const noexcept {
+        }
+    };
+}
+
+// Lazily started coroutine returning T, co_await it from another coroutine or block on it with sync_wait
+// Awaiting starts it on the awaiting thread; it runs there until it co_awaits a ThreadPool::schedule()
+// and carries on on that pool's workers, and whoever awaited it is resumed on the thread it finishes on
+// Exceptions are kept and rethrown to the awaiter
+template <class T = void>
+class CoTask {
+public:
+    using promise_type = CoroutineDetail::Promise<T>;
+
+    CoTask() = default;
+
+    explicit CoTask(std::coroutine_handle<promise_type> handle) : handle(handle) {
+    }
+
+    CoTask(CoTask&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {
+    }
+
+    CoTask& operator=(CoTask&& other) noexcept {
+        if (this != &other) {
+            if (handle)
+                handle.destroy();
+            handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+
+    CoTask(const CoTask&) = delete;
+    CoTask& operator=(const CoTask&) = delete;
+
+    ~CoTask() {
+        if (handle)
+            handle.destroy();
+    }
+
+    bool await_ready() const noexcept {
+        return !handle || handle.done();
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+
+    T await_resume() {
+        return handle.promise().result();
+    }
+
+private:
+    template <class U>
+    friend struct CoroutineDetail::WhenAllAwaiter;
+    template <class U>
+    friend U sync_wait(CoTask<U> task);
+    template <class U>
+    friend CoTask<std::vector<U>> when_all(std::vector<CoTask<U>> tasks);
+    friend CoTask<void> when_all(std::vector<CoTask<void>> tasks);
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+template <class T>
+CoTask<T> CoroutineDetail::Promise<T>::get_return_object() {
+    return CoTask<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline CoTask<void> CoroutineDetail::Promise<void>::get_return_object() {
+    return CoTask<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+// Run the task and block the calling thread until it is done, the bridge from plain code into coroutines
+// Only the caller waits, the pools keep running everything else
+template <class T>
+T sync_wait(CoTask<T> task) {
+    CoroutineDetail::Signal signal;
+    CoroutineDetail::Driver driver = CoroutineDetail::drive<T>(task.handle);
+    driver.handle.promise().signal = &signal;
+    driver.handle.resume();
+    signal.wait();
+    return task.handle.promise().result();
+}
+
+// Run every task at once and resume with their results in order once the last one is done
+// The first exception, in task order, is rethrown after all of them have finished
+template <class T>
+CoTask<std::vector<T>> when_all(std::vector<CoTask<T>> tasks) {
+    co_await CoroutineDetail::WhenAllAwaiter<T>{ tasks };
+    std::vector<T> results;
+    results.reserve(tasks.size());
+    for (auto& task : tasks)
+        results.push_back(task.handle.promise().result());
+    co_return results;
+}
+
+inline CoTask<void> when_all(std::vector<CoTask<void>> tasks) {
+    co_await CoroutineDetail::WhenAllAwaiter<void>{ tasks };
+    for (auto& task : tasks)
+        task.handle.promise().result();
+}
+
+#endif // COROUTINE_H
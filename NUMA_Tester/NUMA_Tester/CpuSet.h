@@ -0,0 +1,138 @@
+#ifndef CPU_SET_H
+#define CPU_SET_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <ostream>
+
+// Set of logical CPUs, grows as needed so it is not capped at 64 CPUs like an affinity mask
+// CPU numbering follows the OS: Linux CPU ids, or (group * 64 + bit) for Windows processor groups
+class CpuSet {
+public:
+    CpuSet() = default;
+
+    // Parse a Linux cpulist string such as "0-23,48-71"
+    static CpuSet parse_list(const std::string& list) {
+        CpuSet set;
+        size_t pos = 0;
+        while (pos < list.size()) {
+            size_t end = list.find(',', pos);
+            if (end == std::string::npos)
+                end = list.size();
+            std::string range = list.substr(pos, end - pos);
+            pos = end + 1;
+
+            // Trim the trailing newline sysfs leaves behind
+            while (!range.empty() && (range.back() == '\n' || range.back() == ' '))
+                range.pop_back();
+            if (range.empty())
+                continue;
+
+            size_t dash = range.find('-');
+            size_t first = std::stoul(range.substr(0, dash));
+            size_t last = (dash == std::string::npos) ? first : std::stoul(range.substr(dash + 1));
+            for (size_t cpu = first; cpu <= last; ++cpu)
+                set.set(cpu);
+        }
+        return set;
+    }
+
+    void set(size_t cpu) {
+        if (cpu / 64 >= words.size())
+            words.resize(cpu / 64 + 1, 0);
+        words[cpu / 64] |= 1ULL << (cpu % 64);
+    }
+
+    void clear(size_t cpu) {
+        if (cpu / 64 < words.size())
+            words[cpu / 64] &= ~(1ULL << (cpu % 64));
+    }
+
+    bool test(size_t cpu) const {
+        return cpu / 64 < words.size() && (words[cpu / 64] & (1ULL << (cpu % 64))) != 0;
+    }
+
+    size_t count() const {
+        size_t total = 0;
+        for (uint64_t word : words) {
+            for (; word; word &= word - 1)
+                ++total;
+        }
+        return total;
+    }
+
+    bool empty() const {
+        return count() == 0;
+    }
+
+    // One past the highest CPU that could be set
+    size_t capacity() const {
+        return words.size() * 64;
+    }
+
+    // The CPU ids in ascending order
+    std::vector<size_t> cpus() const {
+        std::vector<size_t> result;
+        for (size_t cpu = 0; cpu < capacity(); ++cpu) {
+            if (test(cpu))
+                result.push_back(cpu);
+        }
+        return result;
+    }
+
+    // Lowest CPU id in the set, useful as a stable id for a domain (core, L3)
+    size_t first() const {
+        for (size_t cpu = 0; cpu < capacity(); ++cpu) {
+            if (test(cpu))
+                return cpu;
+        }
+        return SIZE_MAX;
+    }
+
+    // The 64 CPUs of one word, i.e. one Windows processor group
+    uint64_t word(size_t index) const {
+        return index < words.size() ? words[index] : 0;
+    }
+
+    CpuSet& operator|=(const CpuSet& other) {
+        if (other.words.size() > words.size())
+            words.resize(other.words.size(), 0);
+        for (size_t i = 0; i < other.words.size(); ++i)
+            words[i] |= other.words[i];
+        return *this;
+    }
+
+    bool operator==(const CpuSet& other) const {
+        size_t n = std::max(words.size(), other.words.size());
+        for (size_t i = 0; i < n; ++i) {
+            if (word(i) != other.word(i))
+                return false;
+        }
+        return true;
+    }
+
+    // Print back in cpulist form
+    friend std::ostream& operator<<(std::ostream& os, const CpuSet& set) {
+        auto ids = set.cpus();
+        for (size_t i = 0; i < ids.size(); ) {
+            size_t j = i;
+            while (j + 1 < ids.size() && ids[j + 1] == ids[j] + 1)
+                ++j;
+            if (i != 0)
+                os << ',';
+            os << ids[i];
+            if (j != i)
+                os << '-' << ids[j];
+            i = j + 1;
+        }
+        return os;
+    }
+
+private:
+    std::vector<uint64_t> words;
+};
+
+#endif // CPU_SET_H
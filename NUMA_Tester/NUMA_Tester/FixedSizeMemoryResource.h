@@ -12,10 +12,6 @@ public:
 
 protected:
     void* do_allocate(size_t bytes, size_t alignment) override {
-        static size_t lastbytes = 0;
-        if (lastbytes != bytes) {
-            lastbytes = bytes;
-        }
         void* ptr = static_cast<char*>(_buffer) + _used;
         size_t space = _size - _used;
         void* aligned_ptr = std::align(alignment, bytes, ptr, space);
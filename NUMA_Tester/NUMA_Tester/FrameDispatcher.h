@@ -0,0 +1,147 @@
+#ifndef FRAME_DISPATCHER_H
+#define FRAME_DISPATCHER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "Constants.h"
+#include "MemoryAllocator.h"
+#include "Platform.h"
+#include "ThreadPool.h"
+#include "Topology.h"
+
+struct DispatcherOptions {
+    size_t spill_depth = 0;     // Pending Tasks on the home pool before spilling, 0 for twice its threads
+    bool page_query = true;     // Ask the OS where a buffer outside the Node pools lives
+};
+
+// Runs work on the pool of the Node a buffer lives on, so callers only need the pointer
+// The home Node comes from the Node pools' address ranges, a sorted copy kept from construction,
+// and for anything outside them from the OS page location query
+// When the home pool already has spill_depth Tasks pending the work goes to the nearest Node
+// (by firmware distance) that is below it, and is counted as spilled; if every pool is that deep it stays home
+class FrameDispatcher {
+public:
+    // Where a dispatched buffer went, per home Node
+    struct Stats {
+        uint64_t local = 0;         // Ran on the home Node
+        uint64_t spilled = 0;       // Home pool too deep, ran on a nearer Node
+        uint64_t unknown = 0;       // Home not found, ran on the calling thread's Node (counted there)
+    };
+
+    FrameDispatcher(const Topology& topology, const std::vector<std::unique_ptr<MemoryAllocator>>& allocators,
+        const std::vector<std::unique_ptr<ThreadPool>>& thread_pools, const DispatcherOptions& dispatcher_options = {})
+        : topology(topology), options(dispatcher_options), counters(allocators.size()) {
+        for (size_t node = 0; node < allocators.size(); ++node) {
+            const std::byte* begin = allocators[node]->get_buffer();
+            ranges.push_back({ begin, begin + allocators[node]->get_buffer_size(), node });
+        }
+        std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) { return a.begin < b.begin; });
+
+        for (size_t node = 0; node < thread_pools.size(); ++node) {
+            pools.push_back(thread_pools[node].get());
+            spill_order.push_back(topology.nodes_by_distance(node));
+            spill_depths.push_back(options.spill_depth ? options.spill_depth : 2 * thread_pools[node]->get_num_threads());
+        }
+    }
+
+    // Topology index of the Node the buffer lives on, -1 if neither the ranges nor the OS know
+    int home_node(const void* ptr) {
+        const std::byte* byte = static_cast<const std::byte*>(ptr);
+        auto after = std::upper_bound(ranges.begin(), ranges.end(), byte, [](const std::byte* p, const Range& range) { return p < range.begin; });
+        if (after != ranges.begin() && byte < std::prev(after)->end)
+            return static_cast<int>(std::prev(after)->node);
+
+        if (!options.page_query)
+            return -1;
+        page_queries.fetch_add(1, std::memory_order_relaxed);
+        const int os_node = Platform::page_node(ptr);
+        for (size_t node = 0; node < topology.num_nodes(); ++node) {
+            if (os_node >= 0 && topology.get_nodes()[node].id == static_cast<size_t>(os_node))
+                return static_cast<int>(node);
+        }
+        return -1;
+    }
+
+    // Run work() on the buffer's home Node, or the nearest one with room, returns the Node it went to
+    template <class F>
+    size_t dispatch(const void* buffer, F&& work) {
+        const int home = home_node(buffer);
+        if (home < 0) {
+            const size_t caller = topology.node_of_cpu(Platform::current_cpu());
+            counters[caller].unknown.fetch_add(1, std::memory_order_relaxed);
+            pools[caller]->enqueue(std::forward<F>(work));
+            return caller;
+        }
+
+        const size_t node = static_cast<size_t>(home);
+        size_t target = node;
+        if (pools[node]->get_pending() >= spill_depths[node]) {
+            for (size_t other : spill_order[node]) {
+                if (pools[other]->get_pending() < spill_depths[other]) {
+                    target = other;
+                    break;
+                }
+            }
+        }
+        (target == node ? counters[node].local : counters[node].spilled).fetch_add(1, std::memory_order_relaxed);
+        pools[target]->enqueue(std::forward<F>(work));
+        return target;
+    }
+
+    // Counts for buffers whose home is the Node
+    Stats get_stats(size_t node) const {
+        Stats stats;
+        stats.local = counters[node].local.load(std::memory_order_relaxed);
+        stats.spilled = counters[node].spilled.load(std::memory_order_relaxed);
+        stats.unknown = counters[node].unknown.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    void reset_stats() {
+        for (auto& counter : counters) {
+            counter.local.store(0);
+            counter.spilled.store(0);
+            counter.unknown.store(0);
+        }
+        page_queries.store(0);
+    }
+
+    // Buffers outside the Node pools looked up with the OS
+    uint64_t get_page_queries() const {
+        return page_queries.load(std::memory_order_relaxed);
+    }
+
+    size_t get_spill_depth(size_t node) const {
+        return spill_depths[node];
+    }
+
+private:
+    struct Range {
+        const std::byte* begin;
+        const std::byte* end;
+        size_t node;
+    };
+
+    // Dispatch can come from any thread, one cache line per Node keeps them from false sharing
+    struct alignas(CACHE_LINE_SIZE) Counters {
+        std::atomic<uint64_t> local{ 0 };
+        std::atomic<uint64_t> spilled{ 0 };
+        std::atomic<uint64_t> unknown{ 0 };
+    };
+
+    const Topology& topology;
+    DispatcherOptions options;
+    std::vector<Range> ranges;
+    std::vector<ThreadPool*> pools;
+    std::vector<std::vector<size_t>> spill_order;
+    std::vector<size_t> spill_depths;
+    std::vector<Counters> counters;
+    std::atomic<uint64_t> page_queries{ 0 };
+};
+
+#endif // FRAME_DISPATCHER_H
@@ -0,0 +1,409 @@
+#ifndef FRAME_KERNELS_H
+#define FRAME_KERNELS_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Constants.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define FRAME_KERNELS_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC emits any intrinsic without a flag, GCC/Clang need the target on the function
+#if defined(FRAME_KERNELS_X86) && !defined(_MSC_VER)
+#define KERNEL_TARGET(isa) __attribute__((target(isa)))
+#else
+#define KERNEL_TARGET(isa)
+#endif
+
+// What a Frame kernel does to the Frame, and a per-ISA implementation picked at runtime
+// Every kernel has the signature void(std::byte* frame, size_t size)
+//   fill        write only, std::fill of 0xAA (the original process_frame)
+//   stream      write only with non-temporal stores, bypasses the caches
+//   checksum    read only, 64-bit sum of the Frame
+//   copy        read the first half, write it over the second half
+//   rmw         read-modify-write, xor every byte with 0x5A
+//   rgb24_nv12  BT.601 RGB24 -> NV12 of the whole Frame as FRAME_WIDTH wide rows into a per-thread buffer
+using FrameKernel = void (*)(std::byte* frame, size_t size);
+
+enum class Isa {
+    Scalar,
+    SSE2,
+    AVX2,
+    AVX512
+};
+
+inline const char* isa_name(Isa isa) {
+    switch (isa) {
+    case Isa::SSE2: return "sse2";
+    case Isa::AVX2: return "avx2";
+    case Isa::AVX512: return "avx512";
+    default: return "scalar";
+    }
+}
+
+// Best instruction set the CPU and OS support
+inline Isa detect_isa() {
+#ifdef FRAME_KERNELS_X86
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    __cpuidex(info, 7, 0);
+    const bool avx2 = (info[1] & (1 << 5)) != 0;
+    const bool avx512f = (info[1] & (1 << 16)) != 0;
+    if (avx512f && (xcr0 & 0xE6) == 0xE6)
+        return Isa::AVX512;
+    if (avx && avx2 && (xcr0 & 0x6) == 0x6)
+        return Isa::AVX2;
+    return Isa::SSE2;
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return Isa::AVX512;
+    if (__builtin_cpu_supports("avx2"))
+        return Isa::AVX2;
+    return Isa::SSE2;
+#endif
+#else
+    return Isa::Scalar;
+#endif
+}
+
+namespace FrameKernels {
+
+    // Read only kernels store their result here so the compiler can not drop the loads
+    inline std::atomic<uint64_t> checksum_sink{ 0 };
+
+    // Bytes before the first aligned address, clamped to size
+    inline size_t head_bytes(const std::byte* ptr, size_t alignment, size_t size) {
+        size_t misalignment = reinterpret_cast<uintptr_t>(ptr) & (alignment - 1);
+        return std::min(size, misalignment ? alignment - misalignment : 0);
+    }
+
+    // ---- Scalar ----
+
+    inline void fill_scalar(std::byte* frame, size_t size) {
+        std::fill(frame, frame + size, std::byte{ 0xAA });
+    }
+
+    inline void checksum_scalar(std::byte* frame, size_t size) {
+        uint64_t sum = 0;
+        size_t words = size / sizeof(uint64_t);
+        for (size_t i = 0; i < words; ++i) {
+            uint64_t word;
+            std::memcpy(&word, frame + i * sizeof(uint64_t), sizeof(word));
+            sum += word;
+        }
+        for (size_t i = words * sizeof(uint64_t); i < size; ++i)
+            sum += static_cast<uint64_t>(frame[i]);
+        checksum_sink.fetch_add(sum, std::memory_order_relaxed);
+    }
+
+    inline void copy_scalar(std::byte* frame, size_t size) {
+        std::memcpy(frame + size / 2, frame, size / 2);
+    }
+
+    inline void rmw_scalar(std::byte* frame, size_t size) {
+        for (size_t i = 0; i < size; ++i)
+            frame[i] ^= std::byte{ 0x5A };
+    }
+
+    // BT.601 limited range, 8 bit fixed point, of a width x height RGB24 image (both even) into NV12:
+    // Y plane is W x H, then interleaved UV at half resolution (one pair per 2x2 block)
+    inline void rgb24_nv12_image(const uint8_t* rgb, size_t width, size_t height, uint8_t* y_plane) {
+        uint8_t* uv_plane = y_plane + width * height;
+
+        for (size_t row = 0; row < height; ++row) {
+            const uint8_t* src = rgb + row * width * 3;
+            uint8_t* y = y_plane + row * width;
+            for (size_t col = 0; col < width; ++col) {
+                int r = src[col * 3], g = src[col * 3 + 1], b = src[col * 3 + 2];
+                y[col] = static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+            }
+        }
+
+        for (size_t row = 0; row < height; row += 2) {
+            const uint8_t* top = rgb + row * width * 3;
+            const uint8_t* bottom = top + width * 3;
+            uint8_t* uv = uv_plane + (row / 2) * width;
+            for (size_t col = 0; col < width; col += 2) {
+                int r = top[col * 3] + top[col * 3 + 3] + bottom[col * 3] + bottom[col * 3 + 3];
+                int g = top[col * 3 + 1] + top[col * 3 + 4] + bottom[col * 3 + 1] + bottom[col * 3 + 4];
+                int b = top[col * 3 + 2] + top[col * 3 + 5] + bottom[col * 3 + 2] + bottom[col * 3 + 5];
+                r >>= 2; g >>= 2; b >>= 2;
+                uv[col] = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+                uv[col + 1] = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+            }
+        }
+    }
+
+    // The Frame is read as FRAME_WIDTH wide rows for as many row pairs as fit, which is FRAME_HEIGHT rows for
+    // the default Frame size, and the bytes left after that as narrower two row strips, so any Frame size is
+    // converted to within its last 11 bytes (less than one 2x2 block)
+    inline void rgb24_nv12_scalar(std::byte* frame, size_t size) {
+        // The NV12 output lives on the thread's own Node, only the RGB input is the Frame's memory
+        // NV12 is half the size of RGB24, so size / 2 holds every strip
+        static thread_local std::vector<uint8_t> nv12;
+        if (nv12.size() < size / 2)
+            nv12.resize(size / 2);
+
+        const uint8_t* rgb = reinterpret_cast<const uint8_t*>(frame);
+        uint8_t* out = nv12.data();
+        size_t remaining = size;
+        while (remaining >= 12) {
+            const size_t width = std::min<size_t>(FRAME_WIDTH, remaining / 6) & ~size_t{ 1 };
+            const size_t height = (remaining / (width * 3)) & ~size_t{ 1 };
+            rgb24_nv12_image(rgb, width, height, out);
+            rgb += width * height * 3;
+            out += width * height * 3 / 2;
+            remaining -= width * height * 3;
+        }
+    }
+
+#ifdef FRAME_KERNELS_X86
+
+    // ---- SSE2 ----
+
+    KERNEL_TARGET("sse2") inline void fill_sse2(std::byte* frame, size_t size) {
+        const __m128i value = _mm_set1_epi8(static_cast<char>(0xAA));
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16)
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(frame + i), value);
+        fill_scalar(frame + i, size - i);
+    }
+
+    KERNEL_TARGET("sse2") inline void stream_sse2(std::byte* frame, size_t size) {
+        const __m128i value = _mm_set1_epi8(static_cast<char>(0xAA));
+        size_t i = head_bytes(frame, 16, size);
+        fill_scalar(frame, i);
+        for (; i + 16 <= size; i += 16)
+            _mm_stream_si128(reinterpret_cast<__m128i*>(frame + i), value);
+        _mm_sfence();
+        fill_scalar(frame + i, size - i);
+    }
+
+    KERNEL_TARGET("sse2") inline void checksum_sse2(std::byte* frame, size_t size) {
+        __m128i sum = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16)
+            sum = _mm_add_epi64(sum, _mm_loadu_si128(reinterpret_cast<const __m128i*>(frame + i)));
+        uint64_t lanes[2];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), sum);
+        checksum_sink.fetch_add(lanes[0] + lanes[1], std::memory_order_relaxed);
+        checksum_scalar(frame + i, size - i);
+    }
+
+    KERNEL_TARGET("sse2") inline void copy_sse2(std::byte* frame, size_t size) {
+        const size_t half = size / 2;
+        std::byte* dst = frame + half;
+        size_t i = 0;
+        for (; i + 16 <= half; i += 16)
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_loadu_si128(reinterpret_cast<const __m128i*>(frame + i)));
+        std::memcpy(dst + i, frame + i, half - i);
+    }
+
+    KERNEL_TARGET("sse2") inline void rmw_sse2(std::byte* frame, size_t size) {
+        const __m128i key = _mm_set1_epi8(0x5A);
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+            __m128i* ptr = reinterpret_cast<__m128i*>(frame + i);
+            _mm_storeu_si128(ptr, _mm_xor_si128(_mm_loadu_si128(ptr), key));
+        }
+        rmw_scalar(frame + i, size - i);
+    }
+
+    // ---- AVX2 ----
+
+    KERNEL_TARGET("avx2") inline void fill_avx2(std::byte* frame, size_t size) {
+        const __m256i value = _mm256_set1_epi8(static_cast<char>(0xAA));
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32)
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(frame + i), value);
+        fill_scalar(frame + i, size - i);
+    }
+
+    KERNEL_TARGET("avx2") inline void stream_avx2(std::byte* frame, size_t size) {
+        const __m256i value = _mm256_set1_epi8(static_cast<char>(0xAA));
+        size_t i = head_bytes(frame, 32, size);
+        fill_scalar(frame, i);
+        for (; i + 32 <= size; i += 32)
+            _mm256_stream_si256(reinterpret_cast<__m256i*>(frame + i), value);
+        _mm_sfence();
+        fill_scalar(frame + i, size - i);
+    }
+
+    KERNEL_TARGET("avx2") inline void checksum_avx2(std::byte* frame, size_t size) {
+        __m256i sum = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32)
+            sum = _mm256_add_epi64(sum, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(frame + i)));
+        uint64_t lanes[4];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), sum);
+        checksum_sink.fetch_add(lanes[0] + lanes[1] + lanes[2] + lanes[3], std::memory_order_relaxed);
+        checksum_scalar(frame + i, size - i);
+    }
+
+    KERNEL_TARGET("avx2") inline void copy_avx2(std::byte* frame, size_t size) {
+        const size_t half = size / 2;
+        std::byte* dst = frame + half;
+        size_t i = 0;
+        for (; i + 32 <= half; i += 32)
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(frame + i)));
+        std::memcpy(dst + i, frame + i, half - i);
+    }
+
+    KERNEL_TARGET("avx2") inline void rmw_avx2(std::byte* frame, size_t size) {
+        const __m256i key = _mm256_set1_epi8(0x5A);
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32) {
+            __m256i* ptr = reinterpret_cast<__m256i*>(frame + i);
+            _mm256_storeu_si256(ptr, _mm256_xor_si256(_mm256_loadu_si256(ptr), key));
+        }
+        rmw_scalar(frame + i, size - i);
+    }
+
+    // ---- AVX-512 (F only) ----
+
+    KERNEL_TARGET("avx512f") inline void fill_avx512(std::byte* frame, size_t size) {
+        const __m512i value = _mm512_set1_epi64(static_cast<long long>(0xAAAAAAAAAAAAAAAAULL));
+        size_t i = 0;
+        for (; i + 64 <= size; i += 64)
+            _mm512_storeu_si512(frame + i, value);
+        fill_scalar(frame + i, size - i);
+    }
+
+    KERNEL_TARGET("avx512f") inline void stream_avx512(std::byte* frame, size_t size) {
+        const __m512i value = _mm512_set1_epi64(static_cast<long long>(0xAAAAAAAAAAAAAAAAULL));
+        size_t i = head_bytes(frame, 64, size);
+        fill_scalar(frame, i);
+        for (; i + 64 <= size; i += 64)
+            _mm512_stream_si512(reinterpret_cast<__m512i*>(frame + i), value);
+        _mm_sfence();
+        fill_scalar(frame + i, size - i);
+    }
+
+    KERNEL_TARGET("avx512f") inline void checksum_avx512(std::byte* frame, size_t size) {
+        __m512i sum = _mm512_setzero_si512();
+        size_t i = 0;
+        for (; i + 64 <= size; i += 64)
+            sum = _mm512_add_epi64(sum, _mm512_loadu_si512(frame + i));
+        uint64_t lanes[8];
+        _mm512_storeu_si512(lanes, sum);
+        uint64_t total = 0;
+        for (uint64_t lane : lanes)
+            total += lane;
+        checksum_sink.fetch_add(total, std::memory_order_relaxed);
+        checksum_scalar(frame + i, size - i);
+    }
+
+    KERNEL_TARGET("avx512f") inline void copy_avx512(std::byte* frame, size_t size) {
+        const size_t half = size / 2;
+        std::byte* dst = frame + half;
+        size_t i = 0;
+        for (; i + 64 <= half; i += 64)
+            _mm512_storeu_si512(dst + i, _mm512_loadu_si512(frame + i));
+        std::memcpy(dst + i, frame + i, half - i);
+    }
+
+    KERNEL_TARGET("avx512f") inline void rmw_avx512(std::byte* frame, size_t size) {
+        const __m512i key = _mm512_set1_epi64(0x5A5A5A5A5A5A5A5AULL);
+        size_t i = 0;
+        for (; i + 64 <= size; i += 64)
+            _mm512_storeu_si512(frame + i, _mm512_xor_si512(_mm512_loadu_si512(frame + i), key));
+        rmw_scalar(frame + i, size - i);
+    }
+
+#endif // FRAME_KERNELS_X86
+}
+
+// Runtime table of the Frame kernels, each name has one entry per ISA it was written for
+// find() hands back the widest variant the CPU supports, capped by an optional ISA limit
+class KernelRegistry {
+public:
+    struct Entry {
+        std::string name;
+        Isa isa;
+        FrameKernel kernel;
+    };
+
+    static KernelRegistry& instance() {
+        static KernelRegistry registry;
+        return registry;
+    }
+
+    // Register another kernel variant, e.g. a workload specific one from main
+    void add(const std::string& name, Isa isa, FrameKernel kernel) {
+        entries.push_back({ name, isa, kernel });
+    }
+
+    // Widest variant of name at or below max_isa and the CPU's ISA, nullptr if name is unknown
+    const Entry* find(const std::string& name, Isa max_isa = Isa::AVX512) const {
+        const Isa limit = std::min(max_isa, cpu_isa);
+        const Entry* best = nullptr;
+        for (const auto& entry : entries) {
+            if (entry.name == name && entry.isa <= limit && (!best || entry.isa > best->isa))
+                best = &entry;
+        }
+        return best;
+    }
+
+    // Kernel names in registration order, without duplicates
+    std::vector<std::string> names() const {
+        std::vector<std::string> result;
+        for (const auto& entry : entries) {
+            if (std::find(result.begin(), result.end(), entry.name) == result.end())
+                result.push_back(entry.name);
+        }
+        return result;
+    }
+
+    Isa get_cpu_isa() const {
+        return cpu_isa;
+    }
+
+private:
+    std::vector<Entry> entries;
+    Isa cpu_isa = detect_isa();
+
+    KernelRegistry() {
+        using namespace FrameKernels;
+        add("fill", Isa::Scalar, fill_scalar);
+        add("stream", Isa::Scalar, fill_scalar);
+        add("checksum", Isa::Scalar, checksum_scalar);
+        add("copy", Isa::Scalar, copy_scalar);
+        add("rmw", Isa::Scalar, rmw_scalar);
+        add("rgb24_nv12", Isa::Scalar, rgb24_nv12_scalar);
+#ifdef FRAME_KERNELS_X86
+        add("fill", Isa::SSE2, fill_sse2);
+        add("stream", Isa::SSE2, stream_sse2);
+        add("checksum", Isa::SSE2, checksum_sse2);
+        add("copy", Isa::SSE2, copy_sse2);
+        add("rmw", Isa::SSE2, rmw_sse2);
+        add("fill", Isa::AVX2, fill_avx2);
+        add("stream", Isa::AVX2, stream_avx2);
+        add("checksum", Isa::AVX2, checksum_avx2);
+        add("copy", Isa::AVX2, copy_avx2);
+        add("rmw", Isa::AVX2, rmw_avx2);
+        add("fill", Isa::AVX512, fill_avx512);
+        add("stream", Isa::AVX512, stream_avx512);
+        add("checksum", Isa::AVX512, checksum_avx512);
+        add("copy", Isa::AVX512, copy_avx512);
+        add("rmw", Isa::AVX512, rmw_avx512);
+#endif
+    }
+};
+
+#endif // FRAME_KERNELS_H
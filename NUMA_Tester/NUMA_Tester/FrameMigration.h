@@ -0,0 +1,217 @@
+#ifndef FRAME_MIGRATION_H
+#define FRAME_MIGRATION_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "FramePool.h"
+#include "MemoryAllocator.h"
+#include "Platform.h"
+#include "Topology.h"
+
+// How a Frame gets to another Node
+enum class MigrationMode {
+    Auto,       // Move the pages, copy if the OS will not
+    MovePages,  // Move the pages in place (move_pages), the Frame keeps its address, fails where unsupported
+    Copy        // Copy into a Frame leased from the target Node, the Frame gets a new address
+};
+
+struct MigrationOptions {
+    uint32_t remote_uses = 2;   // Migrate a Frame once a remote Node has consumed it more than this many times in a row
+    MigrationMode mode = MigrationMode::Auto;
+};
+
+// Moves Frames of the Node pools to the Node consuming them
+// consume() counts back to back uses from the same remote Node and migrates the Frame once they pass the threshold;
+// migrate() and migrate_range() move on demand
+// A copied Frame lives on in a lease from the FramePool, consume() hands back that address from then on
+// Copying assumes nobody writes the Frame while it moves, moving pages does not need that
+class FrameMigrator {
+public:
+    struct Stats {
+        uint64_t migrations = 0;    // Frames moved
+        uint64_t pages_moved = 0;   // Pages moved in place, huge pages count once
+        uint64_t bytes_copied = 0;  // Bytes copied to leased Frames
+        uint64_t failed = 0;        // Migrations that could not be done (no free Frame on the target, OS refused)
+        double seconds = 0.0;       // Time spent moving
+    };
+
+    FrameMigrator(const Topology& topology, const std::vector<std::unique_ptr<MemoryAllocator>>& allocators,
+        FramePool& frame_pool, const MigrationOptions& migration_options = {})
+        : topology(topology), frame_pool(frame_pool), options(migration_options) {
+        size_t total = 0;
+        for (const auto& allocator : allocators)
+            total += allocator->getFrames().size();
+        states = std::make_unique<FrameState[]>(total);
+
+        size_t index = 0;
+        for (size_t node = 0; node < allocators.size(); ++node) {
+            for (std::byte* frame : allocators[node]->getFrames()) {
+                indices[frame] = index;
+                states[index].data.store(frame);
+                states[index].node.store(node);
+                states[index].frame = frame;
+                states[index].home = node;
+                states[index].size = allocators[node]->get_frame_size();
+                states[index].page = allocators[node]->get_page_size();
+                ++index;
+            }
+        }
+        leases.resize(total);
+    }
+
+    FrameMigrator(const FrameMigrator&) = delete;
+    FrameMigrator& operator=(const FrameMigrator&) = delete;
+
+    // Record that consumer_node (Topology index) is about to use the Frame, migrating it there if the policy says so
+    // Returns the address to use, the Frame's own unless it has been copied; unknown pointers come back unchanged
+    std::byte* consume(std::byte* frame, size_t consumer_node) {
+        FrameState* state = find(frame);
+        if (!state)
+            return frame;
+
+        const size_t node = state->node.load(std::memory_order_relaxed);
+        if (node == consumer_node) {
+            state->remote_uses.store(0, std::memory_order_relaxed);
+            return state->data.load(std::memory_order_acquire);
+        }
+
+        // A different remote consumer starts the count again
+        if (state->consumer.exchange(consumer_node, std::memory_order_relaxed) != consumer_node)
+            state->remote_uses.store(0, std::memory_order_relaxed);
+        if (state->remote_uses.fetch_add(1, std::memory_order_relaxed) + 1 > options.remote_uses)
+            move(*state, consumer_node);
+        return state->data.load(std::memory_order_acquire);
+    }
+
+    // Move the Frame to the Node now, returns the address to use from now on, nullptr if it could not be moved
+    std::byte* migrate(std::byte* frame, size_t node) {
+        FrameState* state = find(frame);
+        if (!state || !move(*state, node))
+            return nullptr;
+        return state->data.load(std::memory_order_acquire);
+    }
+
+    // Move any range of pages in place, for buffers that are not Frames, returns the pages moved, -1 if the OS can not
+    // page is the range's page size, 0 for the default page
+    long migrate_range(void* ptr, size_t bytes, size_t node, size_t page = 0) {
+        auto start = std::chrono::high_resolution_clock::now();
+        long moved = Platform::move_to_node(ptr, bytes, topology.get_nodes()[node].id, page);
+        std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - start;
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.seconds += duration.count();
+        if (moved > 0)
+            stats.pages_moved += static_cast<uint64_t>(moved);
+        else
+            ++stats.failed;
+        return moved;
+    }
+
+    // Node (Topology index) the Frame is on now, its home Node until it migrates
+    size_t get_node(std::byte* frame) const {
+        const FrameState* state = find(frame);
+        return state ? state->node.load(std::memory_order_relaxed) : 0;
+    }
+
+    // Put every migrated Frame back on its home Node, copies go back into the original Frame
+    void restore() {
+        for (size_t index = 0; index < leases.size(); ++index) {
+            FrameState& state = states[index];
+            if (state.node.load() != state.home)
+                move(state, state.home);
+            state.remote_uses.store(0);
+        }
+    }
+
+    Stats get_stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+
+private:
+    struct FrameState {
+        std::atomic<std::byte*> data{ nullptr };    // Where the Frame's contents are now
+        std::atomic<size_t> node{ 0 };              // Node they are on
+        std::atomic<size_t> consumer{ SIZE_MAX };   // Last remote Node to use the Frame
+        std::atomic<uint32_t> remote_uses{ 0 };     // Back to back uses by that Node
+        std::byte* frame = nullptr;                 // The Frame itself, in its home Node's pool
+        size_t home = 0;
+        size_t size = 0;
+        size_t page = 0;                            // Page size of the home pool, what move_to_node steps by
+    };
+
+    const Topology& topology;
+    FramePool& frame_pool;
+    MigrationOptions options;
+    std::unordered_map<const std::byte*, size_t> indices;   // Frame -> state index, read only after construction
+    std::unique_ptr<FrameState[]> states;
+    std::vector<FrameLease> leases;                         // Copy target of each Frame that has one, under mutex
+    mutable std::mutex mutex;
+    Stats stats;
+
+    FrameState* find(const std::byte* frame) const {
+        auto it = indices.find(frame);
+        return it == indices.end() ? nullptr : &states[it->second];
+    }
+
+    // Migrations are rare next to uses, one at a time keeps the copy leases simple
+    bool move(FrameState& state, size_t node) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (state.node.load() == node)
+            return true;
+        const size_t index = static_cast<size_t>(&state - states.get());
+        std::byte* home_frame = state.frame;
+        auto start = std::chrono::high_resolution_clock::now();
+
+        bool moved = false;
+        std::byte* current = state.data.load();
+        if (options.mode != MigrationMode::Copy && current == home_frame) {
+            long pages = Platform::move_to_node(current, state.size, topology.get_nodes()[node].id, state.page);
+            if (pages > 0) {
+                stats.pages_moved += static_cast<uint64_t>(pages);
+                moved = true;
+            }
+        }
+        if (!moved && options.mode != MigrationMode::MovePages) {
+            if (node == state.home) {
+                // Back into the Frame itself, its pages never left home
+                std::memcpy(home_frame, current, state.size);
+                state.data.store(home_frame, std::memory_order_release);
+                leases[index] = FrameLease();
+                stats.bytes_copied += state.size;
+                moved = true;
+            }
+            else {
+                FrameLease target = frame_pool.acquire(node);
+                if (target && target.get_node() == node) {
+                    std::memcpy(target.data(), current, state.size);
+                    state.data.store(target.data(), std::memory_order_release);
+                    leases[index] = std::move(target);
+                    stats.bytes_copied += state.size;
+                    moved = true;
+                }
+            }
+        }
+
+        std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - start;
+        stats.seconds += duration.count();
+        if (!moved) {
+            // Wait for another full run of remote uses before trying again
+            state.remote_uses.store(0);
+            ++stats.failed;
+            return false;
+        }
+        state.node.store(node);
+        state.remote_uses.store(0);
+        ++stats.migrations;
+        return true;
+    }
+};
+
+#endif // FRAME_MIGRATION_H
@@ -0,0 +1,321 @@
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "Constants.h"
+#include "MemoryAllocator.h"
+#include "Platform.h"
+#include "Topology.h"
+
+class FramePool;
+
+// RAII handle to a checked out Frame, goes back to its pool when destroyed
+class FrameLease {
+public:
+    FrameLease() = default;
+
+    FrameLease(FrameLease&& other) noexcept
+        : pool(std::exchange(other.pool, nullptr)), frame(other.frame), index(other.index), node(other.node) {
+    }
+
+    FrameLease& operator=(FrameLease&& other) noexcept {
+        if (this != &other) {
+            release();
+            pool = std::exchange(other.pool, nullptr);
+            frame = other.frame;
+            index = other.index;
+            node = other.node;
+        }
+        return *this;
+    }
+
+    FrameLease(const FrameLease&) = delete;
+    FrameLease& operator=(const FrameLease&) = delete;
+
+    ~FrameLease() {
+        release();
+    }
+
+    explicit operator bool() const {
+        return pool != nullptr;
+    }
+
+    std::byte* data() const {
+        return frame;
+    }
+
+    // Node index (into the Topology) the Frame's memory lives on
+    size_t get_node() const {
+        return node;
+    }
+
+    // Hand the Frame back early
+    inline void release();
+
+private:
+    friend class FramePool;
+
+    FrameLease(FramePool* pool, std::byte* frame, uint32_t index, size_t node)
+        : pool(pool), frame(frame), index(index), node(node) {
+    }
+
+    FramePool* pool = nullptr;
+    std::byte* frame = nullptr;
+    uint32_t index = 0;
+    size_t node = 0;
+};
+
+// Lock free pool of the Frames carved by each Node's MemoryAllocator
+// Every Node has a Treiber stack of free Frames (index + ABA tag in one 64 bit word) and every thread
+// keeps a few Frames of its own Node in a private cache, so an uncontended acquire/release is a couple of loads
+// The caches are private, so a long lived thread that is done with the pool for a while should flush() its own
+// When the requested Node is empty the nearest Node by distance is used and counted as a remote fallback
+class FramePool {
+public:
+    // Per thread cache depth, bounds how many Frames one thread can hold back from the shared list
+    static constexpr uint32_t CACHE_SIZE = 8;
+
+    struct NodeStats {
+        uint64_t local_acquires = 0;     // Served from the requested Node
+        uint64_t remote_fallbacks = 0;   // Requested Node was dry, served from another Node
+        uint64_t failed_acquires = 0;    // Every Node was dry
+    };
+
+    // allocators[i] is the MemoryAllocator for Topology Node index i
+    FramePool(const std::vector<std::unique_ptr<MemoryAllocator>>& allocators, const Topology& topology)
+        : shared(std::make_shared<Shared>()), topology(topology) {
+        static std::atomic<uint64_t> next_id{ 1 };
+        shared->id = next_id.fetch_add(1);
+        shared->nodes = std::vector<NodeList>(allocators.size());
+
+        for (size_t node = 0; node < allocators.size(); ++node) {
+            node_allocators.push_back(allocators[node].get());
+            const auto& node_frames = allocators[node]->getFrames();
+            for (std::byte* frame : node_frames) {
+                frames.push_back(frame);
+                frame_nodes.push_back(node);
+            }
+        }
+
+        // Chain every Frame into its Node's free list
+        shared->next = std::make_unique<std::atomic<uint32_t>[]>(frames.size());
+        for (uint32_t i = static_cast<uint32_t>(frames.size()); i-- > 0; )
+            push(frame_nodes[i], i);
+
+        for (size_t node = 0; node < allocators.size(); ++node)
+            fallback_order.push_back(topology.nodes_by_distance(node));
+    }
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    // Take a Frame from the calling thread's own Node
+    FrameLease acquire() {
+        return acquire(topology.node_of_cpu(Platform::current_cpu()));
+    }
+
+    // Take a Frame from the given Node (Topology index), falling back to the nearest Node that has one
+    // Returns an empty lease if every Node is dry
+    FrameLease acquire(size_t node) {
+        uint32_t index;
+        if (take(node, index)) {
+            shared->nodes[node].stats.local_acquires.fetch_add(1, std::memory_order_relaxed);
+            return lease(index);
+        }
+        for (size_t other : fallback_order[node]) {
+            if (take(other, index)) {
+                shared->nodes[node].stats.remote_fallbacks.fetch_add(1, std::memory_order_relaxed);
+                return lease(index);
+            }
+        }
+        shared->nodes[node].stats.failed_acquires.fetch_add(1, std::memory_order_relaxed);
+        return {};
+    }
+
+    // Hand the calling thread's cached Frames back to the shared lists, for long lived threads (ThreadPool workers)
+    // at the end of a batch, so idle Frames are not stranded where no other thread can take them
+    void flush() {
+        for (auto& entry : thread_caches().caches) {
+            if (entry.pool_id != shared->id)
+                continue;
+            while (entry.count > 0)
+                push(entry.node, entry.frames[--entry.count]);
+        }
+    }
+
+    // Snapshot of the counters for a Node (Topology index)
+    NodeStats get_stats(size_t node) const {
+        const auto& stats = shared->nodes[node].stats;
+        return { stats.local_acquires.load(), stats.remote_fallbacks.load(), stats.failed_acquires.load() };
+    }
+
+    size_t num_frames() const {
+        return frames.size();
+    }
+
+private:
+    friend class FrameLease;
+
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+
+    struct AtomicStats {
+        std::atomic<uint64_t> local_acquires{ 0 };
+        std::atomic<uint64_t> remote_fallbacks{ 0 };
+        std::atomic<uint64_t> failed_acquires{ 0 };
+    };
+
+    // One free list per Node, on its own cache line
+    struct alignas(CACHE_LINE_SIZE) NodeList {
+        std::atomic<uint64_t> head{ pack(EMPTY, 0) };   // Low 32 bits: top Frame index, high 32 bits: ABA tag
+        AtomicStats stats;
+    };
+
+    // State the thread caches can outlive the pool with, so a thread exiting late does not touch freed memory
+    struct Shared {
+        uint64_t id = 0;
+        std::vector<NodeList> nodes;
+        std::unique_ptr<std::atomic<uint32_t>[]> next;  // Free list links, indexed by global Frame index
+    };
+
+    // A thread's private stash of free Frames for one pool and Node
+    struct ThreadCache {
+        uint64_t pool_id = 0;
+        size_t node = 0;
+        std::weak_ptr<Shared> owner;
+        uint32_t count = 0;
+        uint32_t frames[CACHE_SIZE];
+    };
+
+    // Give cached Frames back when the thread exits, if the pool is still alive
+    struct ThreadCaches {
+        std::vector<ThreadCache> caches;
+        ~ThreadCaches() {
+            for (auto& cache : caches) {
+                if (auto owner = cache.owner.lock()) {
+                    for (uint32_t i = 0; i < cache.count; ++i)
+                        push(*owner, cache.node, cache.frames[i]);
+                }
+            }
+        }
+    };
+
+    std::shared_ptr<Shared> shared;
+    const Topology& topology;
+    std::vector<std::byte*> frames;                 // Global Frame index -> memory
+    std::vector<size_t> frame_nodes;                // Global Frame index -> Node
+    std::vector<MemoryAllocator*> node_allocators;  // Node -> its pool, to commit lazy Frames on lease
+    std::vector<std::vector<size_t>> fallback_order;
+
+    static constexpr uint64_t pack(uint32_t index, uint32_t tag) {
+        return (static_cast<uint64_t>(tag) << 32) | index;
+    }
+
+    static void push(Shared& shared, size_t node, uint32_t index) {
+        auto& head = shared.nodes[node].head;
+        uint64_t old_head = head.load(std::memory_order_relaxed);
+        do {
+            shared.next[index].store(static_cast<uint32_t>(old_head), std::memory_order_relaxed);
+        } while (!head.compare_exchange_weak(old_head, pack(index, static_cast<uint32_t>(old_head >> 32) + 1),
+            std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    static bool pop(Shared& shared, size_t node, uint32_t& index) {
+        auto& head = shared.nodes[node].head;
+        uint64_t old_head = head.load(std::memory_order_acquire);
+        while (true) {
+            index = static_cast<uint32_t>(old_head);
+            if (index == EMPTY)
+                return false;
+            // The tag makes the CAS fail if the Frame was popped and pushed back in between
+            uint32_t next = shared.next[index].load(std::memory_order_relaxed);
+            if (head.compare_exchange_weak(old_head, pack(next, static_cast<uint32_t>(old_head >> 32) + 1),
+                std::memory_order_acquire, std::memory_order_acquire))
+                return true;
+        }
+    }
+
+    void push(size_t node, uint32_t index) {
+        push(*shared, node, index);
+    }
+
+    static ThreadCaches& thread_caches() {
+        static thread_local ThreadCaches caches;
+        return caches;
+    }
+
+    // This thread's cache for (this pool, node), created on first use
+    ThreadCache& cache(size_t node) {
+        ThreadCaches& local = thread_caches();
+        for (auto& entry : local.caches) {
+            if (entry.pool_id == shared->id && entry.node == node)
+                return entry;
+        }
+        // Forget caches of pools that have gone away before adding a new one
+        std::erase_if(local.caches, [](const ThreadCache& entry) { return entry.owner.expired(); });
+        ThreadCache entry;
+        entry.pool_id = shared->id;
+        entry.node = node;
+        entry.owner = shared;
+        local.caches.push_back(entry);
+        return local.caches.back();
+    }
+
+    // Node the calling thread is running on, only Frames of this Node are kept in the thread cache
+    // so a thread never sits on Frames another Node's threads are waiting for
+    size_t local_node() const {
+        return topology.node_of_cpu(Platform::current_cpu());
+    }
+
+    // Thread cache first, then the Node's shared list, refilling half the cache in one go
+    bool take(size_t node, uint32_t& index) {
+        if (node != local_node())
+            return pop(*shared, node, index);
+
+        ThreadCache& local = cache(node);
+        if (local.count > 0) {
+            index = local.frames[--local.count];
+            return true;
+        }
+        if (!pop(*shared, node, index))
+            return false;
+        uint32_t extra;
+        while (local.count < CACHE_SIZE / 2 && pop(*shared, node, extra))
+            local.frames[local.count++] = extra;
+        return true;
+    }
+
+    // Back to the thread cache if the Frame is from this thread's Node, spilling half to the shared list when full
+    void give_back(uint32_t index) {
+        const size_t node = frame_nodes[index];
+        if (node != local_node()) {
+            push(node, index);
+            return;
+        }
+
+        ThreadCache& local = cache(node);
+        if (local.count == CACHE_SIZE) {
+            while (local.count > CACHE_SIZE / 2)
+                push(node, local.frames[--local.count]);
+        }
+        local.frames[local.count++] = index;
+    }
+
+    FrameLease lease(uint32_t index) {
+        node_allocators[frame_nodes[index]]->commit(frames[index]);
+        return FrameLease(this, frames[index], index, frame_nodes[index]);
+    }
+};
+
+inline void FrameLease::release() {
+    if (pool) {
+        pool->give_back(index);
+        pool = nullptr;
+    }
+}
+
+#endif // FRAME_POOL_H
@@ -0,0 +1,69 @@
+#ifndef LATENCY_PROBE_H
+#define LATENCY_PROBE_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "Constants.h"
+
+// Dependent load chains for measuring memory latency rather than bandwidth
+// Every cache line of the working set holds a pointer to the next one in a random order,
+// so each load has to wait for the one before it and the prefetchers have nothing to follow
+namespace LatencyProbe {
+
+    inline volatile uintptr_t sink = 0;    // Keeps the chase from being optimized away
+
+    // Frames needed to hold a chain over bytes
+    inline size_t frames_needed(size_t bytes, size_t frame_size) {
+        const size_t lines_per_frame = frame_size / CACHE_LINE_SIZE;
+        const size_t lines = std::max<size_t>(1, bytes / CACHE_LINE_SIZE);
+        return lines_per_frame ? (lines + lines_per_frame - 1) / lines_per_frame : 0;
+    }
+
+    // Link bytes worth of cache lines, taken from the front of frames, into one random cycle
+    // Returns the head, or nullptr if the Frames are too small
+    inline void* build_chain(const std::vector<std::byte*>& frames, size_t frame_size, size_t bytes, uint64_t seed) {
+        const size_t needed = frames_needed(bytes, frame_size);
+        if (needed == 0 || needed > frames.size())
+            return nullptr;
+
+        const size_t lines_per_frame = frame_size / CACHE_LINE_SIZE;
+        const size_t lines = std::max<size_t>(1, bytes / CACHE_LINE_SIZE);
+        std::vector<std::byte*> slots;
+        slots.reserve(lines);
+        for (size_t i = 0; i < lines; ++i)
+            slots.push_back(frames[i / lines_per_frame] + (i % lines_per_frame) * CACHE_LINE_SIZE);
+
+        std::shuffle(slots.begin(), slots.end(), std::mt19937_64(seed));
+        for (size_t i = 0; i < lines; ++i)
+            *reinterpret_cast<void**>(slots[i]) = slots[(i + 1) % lines];
+        return slots.front();
+    }
+
+    // Follow the chain for loads steps after a warmup pass, returns ns per load
+    inline double chase(void* head, size_t loads) {
+        void* p = head;
+        for (size_t i = 0; i < loads / 8; ++i)
+            p = *static_cast<void**>(p);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < loads; i += 8) {
+            p = *static_cast<void**>(p);
+            p = *static_cast<void**>(p);
+            p = *static_cast<void**>(p);
+            p = *static_cast<void**>(p);
+            p = *static_cast<void**>(p);
+            p = *static_cast<void**>(p);
+            p = *static_cast<void**>(p);
+            p = *static_cast<void**>(p);
+        }
+        std::chrono::duration<double, std::nano> duration = std::chrono::high_resolution_clock::now() - start;
+        sink = reinterpret_cast<uintptr_t>(p);
+        return duration.count() / ((loads + 7) / 8 * 8);
+    }
+}
+
+#endif // LATENCY_PROBE_H
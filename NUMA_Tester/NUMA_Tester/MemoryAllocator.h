@@ -3,47 +3,144 @@
 
 #include <vector>
 #include <memory>
-#include <windows.h>
-#include "FixedSizeMemoryResource.h"
-#include "QueryableSynchronizedPoolResource.h"
+#include <atomic>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <thread>
+#include "CpuSet.h"
+#include "Platform.h"
+#include "Topology.h"
 #include "Constants.h"
 
+// Sizes and page backing of a Node pool, the defaults are the compiled in constants
+struct AllocatorOptions {
+    size_t pool_size = POOL_SIZE;
+    size_t frame_size = FRAME_SIZE;
+    Platform::PageBackend backend = Platform::PageBackend::Default;
+    std::vector<size_t> interleave_nodes;   // OS Nodes to spread the pages over round robin, empty binds to the pool's Node
+    bool lazy_commit = false;               // Skip the prefault, each Frame's pages are faulted in on its first lease
+};
+
+// Where a MemoryAllocator's constructor spent its time, in seconds
+struct StartupPhases {
+    double map = 0.0;       // Reserving and binding the pool
+    double prefault = 0.0;  // Faulting the pages in, 0 with lazy_commit
+    double carve = 0.0;     // Cutting the pool into Frames
+    double total = 0.0;
+};
+
+// Where the pages of a pool live
+enum class PoolPlacement {
+    Local,          // Bound to one Node, the MemoryAllocator default
+    Interleaved,    // Round robin over a set of Nodes
+    Replicated      // One copy per Node, each thread reads its own Node's, see ReplicatedPool
+};
+
+inline const char* pool_placement_name(PoolPlacement placement) {
+    switch (placement) {
+    case PoolPlacement::Interleaved: return "interleaved";
+    case PoolPlacement::Replicated: return "replicated";
+    default: return "local";
+    }
+}
+
 // Class to wrap Numa Node specific allocations and pools
 class MemoryAllocator {
 public:
-    MemoryAllocator(DWORD_PTR affinityMask) {
-        // Save to Restore the Affinity Mask
-        hProcess = GetCurrentProcess();
-        DWORD_PTR processAffinityMask, systemAffinityMask;
-        if (!GetProcessAffinityMask(hProcess, &processAffinityMask, &systemAffinityMask)) {
-            std::cerr << "Error getting current affinity mask!" << std::endl;
-            return;
-        }
+    // node is the OS Node number, node_cpus are the CPUs used to prefault the pool from the Node itself
+    // With allocator_options.interleave_nodes the pages go round robin over those instead, node only names the pool
+    MemoryAllocator(size_t node, const CpuSet& node_cpus, const AllocatorOptions& allocator_options = {})
+        : node(node), frame_size(allocator_options.frame_size), lazy(allocator_options.lazy_commit) {
+        auto start = std::chrono::high_resolution_clock::now();
 
-        // Use the fact the current affinity of this thread will allocate on the correct NUMA Node
-        // NOTE: You could do this with VirtualAllocExNuma as well
-        if (!SetProcessAffinityMask(hProcess, affinityMask)) {
-            std::cerr << "Error setting affinity mask!" << std::endl;
-            return;
-        }
+        // Allocate a BIG chunk of memory bound to the Node and build up the Pools of Frames
+        // NOTE: The binding is explicit, no need to change the Process Affinity to get first-touch placement
+        memory = allocator_options.interleave_nodes.empty()
+            ? Platform::allocate_on_node(allocator_options.pool_size, node, allocator_options.backend)
+            : Platform::allocate_on_nodes(allocator_options.pool_size, allocator_options.interleave_nodes, allocator_options.backend);
+        buffer = memory.ptr;
+        buffer_size = allocator_options.pool_size;
+        auto mapped = std::chrono::high_resolution_clock::now();
 
-        // Allocate a BIG chunk of memory and build up the Pools of Frames
-        buffer.resize(POOL_SIZE);
-        upstream_resource = std::make_unique<FixedSizeMemoryResource>(buffer.data(), buffer.size());
+        // Make the pages resident now so the first test does not pay for the page faults
+        if (!lazy)
+            parallel_prefault(node_cpus);
+        auto prefaulted = std::chrono::high_resolution_clock::now();
 
-        options.max_blocks_per_chunk = 128; // Maximum number of blocks per chunk
-        options.largest_required_pool_block = FRAME_SIZE; // Largest block size
+        carve_frames();
+        auto carved = std::chrono::high_resolution_clock::now();
 
-        pool = std::make_unique<QueryableSynchronizedPoolResource>(options, upstream_resource.get());
-        alloc = std::make_unique<ByteAllocator>(pool.get());
+        phases.map = std::chrono::duration<double>(mapped - start).count();
+        phases.prefault = std::chrono::duration<double>(prefaulted - mapped).count();
+        phases.carve = std::chrono::duration<double>(carved - prefaulted).count();
+        phases.total = std::chrono::duration<double>(carved - start).count();
+    }
 
-        // Allocate as many frames as you can in the Pool
-        frames = allocate_max_frames(*alloc);
+    ~MemoryAllocator() {
+        Platform::free_on_node(memory);
+    }
 
-        // Reset the Affinity Mask
-        if (!SetProcessAffinityMask(hProcess, processAffinityMask)) {
-            std::cerr << "Error restoring the original affinity mask!" << std::endl;
-        }
+    MemoryAllocator(const MemoryAllocator&) = delete;
+    MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+    // NUMA Node the pool memory is bound to
+    size_t get_node() const {
+        return node;
+    }
+
+    // Page backing the pool actually got, may be a fallback from the one asked for
+    Platform::PageBackend get_backend() const {
+        return memory.backend;
+    }
+
+    // Bytes in each page of the pool, the huge page size when it got one
+    size_t get_page_size() const {
+        return memory.page;
+    }
+
+    // Bytes in every Frame of this pool
+    size_t get_frame_size() const {
+        return frame_size;
+    }
+
+    // Wall time of the constructor: mapping, prefault and carving
+    double get_construction_seconds() const {
+        return phases.total;
+    }
+
+    const StartupPhases& get_startup_phases() const {
+        return phases;
+    }
+
+    bool is_lazy() const {
+        return lazy;
+    }
+
+    // Fault the Frame's pages in if it has not been yet, a no-op unless lazy_commit
+    // Contents are never written, so a Frame other threads are already using through getFrames() is safe to commit
+    void commit(const std::byte* frame) {
+        if (!lazy)
+            return;
+        const size_t index = static_cast<size_t>(frame - buffer) / frame_size;
+        if (!committed[index].load(std::memory_order_acquire) && !committed[index].exchange(true, std::memory_order_acq_rel))
+            Platform::populate(frames[index], frame_size, memory.page);
+    }
+
+    // True if ptr points into this pool's memory, Frames or not
+    bool contains(const void* ptr) const {
+        const std::byte* byte = static_cast<const std::byte*>(ptr);
+        return byte >= buffer && byte < buffer + buffer_size;
+    }
+
+    // Start and size of the pool's memory
+    const std::byte* get_buffer() const {
+        return buffer;
+    }
+
+    size_t get_buffer_size() const {
+        return buffer_size;
     }
 
     // Return a const reference to the vector of frame pointers for use in the Threaded tests
@@ -52,28 +149,75 @@ public:
     }
 
 private:
-    HANDLE hProcess;
-    std::vector<std::byte> buffer;
-    std::unique_ptr<FixedSizeMemoryResource> upstream_resource;
-    std::pmr::pool_options options;
-    std::unique_ptr<QueryableSynchronizedPoolResource> pool;
-    std::unique_ptr<ByteAllocator> alloc;
+    size_t node;
+    size_t frame_size;
+    bool lazy;
+    Platform::NodeMemory memory;
+    StartupPhases phases;
+    std::byte* buffer = nullptr;
+    size_t buffer_size = 0;
     std::vector<std::byte*> frames;
+    std::unique_ptr<std::atomic<bool>[]> committed;     // Per Frame, only with lazy_commit
+
+    // Fault every page in from threads pinned to the owning Node, one slice each
+    // The pages are already bound to the Node, running on it as well keeps the kernel's zeroing local
+    void parallel_prefault(const CpuSet& node_cpus) {
+        const size_t pages = (buffer_size + memory.page - 1) / memory.page;
+        const size_t num_threads = std::max<size_t>(1, std::min(node_cpus.count(), pages));
+        const size_t pages_per_thread = (pages + num_threads - 1) / num_threads;
+
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < num_threads; ++i) {
+            threads.emplace_back([this, &node_cpus, i, pages_per_thread]() {
+                Platform::pin_current_thread(node_cpus);
+                size_t begin = i * pages_per_thread * memory.page;
+                size_t end = std::min(buffer_size, begin + pages_per_thread * memory.page);
+                if (begin < end)
+                    Platform::prefault(buffer + begin, end - begin, memory.page);
+                });
+        }
+        for (auto& thread : threads)
+            thread.join();
+    }
+
+    // Frames are back to back from the page aligned start of the pool, as many as fit
+    void carve_frames() {
+        const size_t count = frame_size ? buffer_size / frame_size : 0;
+        frames.resize(count);
+        for (size_t i = 0; i < count; ++i)
+            frames[i] = buffer + i * frame_size;
+        if (lazy)
+            committed = std::make_unique<std::atomic<bool>[]>(count);
+    }
+};
 
-    // Helper function to allocate as many frames as possible in the pool
-    std::vector<std::byte*> allocate_max_frames(ByteAllocator& alloc) {
-        std::vector<std::byte*> frames;
-        while (true) {
+// One MemoryAllocator per Topology Node, all built at once, each from a thread pinned to its own Node
+// The first failure is rethrown once every Node is done
+inline std::vector<std::unique_ptr<MemoryAllocator>> create_node_allocators(const Topology& topology, const AllocatorOptions& allocator_options) {
+    const size_t num_nodes = topology.num_nodes();
+    std::vector<std::unique_ptr<MemoryAllocator>> allocators(num_nodes);
+    std::vector<std::exception_ptr> errors(num_nodes);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < num_nodes; ++i) {
+        threads.emplace_back([&topology, &allocator_options, &allocators, &errors, i]() {
+            const auto& node = topology.get_nodes()[i];
+            Platform::pin_current_thread(node.cpus);
             try {
-                frames.push_back(alloc.allocate(FRAME_SIZE));
+                allocators[i] = std::make_unique<MemoryAllocator>(node.id, node.cpus, allocator_options);
             }
-            catch (const std::bad_alloc&) {
-                break; // Stop allocating when the pool is exhausted
+            catch (...) {
+                errors[i] = std::current_exception();
             }
-        }
-        return frames;
+            });
     }
-};
+    for (auto& thread : threads)
+        thread.join();
+    for (const auto& error : errors) {
+        if (error)
+            std::rethrow_exception(error);
+    }
+    return allocators;
+}
 
 #endif // MEMORY_ALLOCATOR_H
 
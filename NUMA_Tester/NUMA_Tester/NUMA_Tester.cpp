@@ -1,39 +1,535 @@
 #include <iostream>
-#include <conio.h>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <stdexcept>
+#include "Platform.h"
+#include "Topology.h"
 #include "NodeManager.h"
+#include "PoolBenchmark.h"
+#include "ArenaBenchmark.h"
+#include "FrameKernels.h"
+#include "BenchmarkHarness.h"
+#include "BenchmarkReport.h"
 
-int main() {
-    // Define the number of nodes and cores per node
-    // TODO - Query the machine architecture
-    const size_t num_nodes = 2;  // Last is ALL NODE
-    const size_t num_cores_per_node = 24; // Number of Cores per Node, this equates to threads per Pool for each Node
+// "64M", "10G", "6220800" -> bytes, K/M/G are powers of 1024, 0 if it does not parse
+static size_t parse_size(const std::string& text) {
+    size_t used = 0;
+    unsigned long long value = 0;
+    try {
+        value = std::stoull(text, &used);
+    }
+    catch (const std::exception&) {
+        return 0;
+    }
+    std::string suffix = text.substr(used);
+    if (suffix == "K" || suffix == "k")
+        value <<= 10;
+    else if (suffix == "M" || suffix == "m")
+        value <<= 20;
+    else if (suffix == "G" || suffix == "g")
+        value <<= 30;
+    else if (!suffix.empty())
+        return 0;
+    return static_cast<size_t>(value);
+}
+
+// The whole text as a non-negative integer, std::invalid_argument naming the text otherwise
+static size_t parse_count(const std::string& text) {
+    size_t used = 0;
+    unsigned long long value = 0;
+    try {
+        if (!text.empty() && std::isdigit(static_cast<unsigned char>(text[0])))
+            value = std::stoull(text, &used);
+    }
+    catch (const std::exception&) {
+        used = 0;
+    }
+    if (used == 0 || used != text.size())
+        throw std::invalid_argument(text);
+    return static_cast<size_t>(value);
+}
+
+// The whole text as a finite number, std::invalid_argument naming the text otherwise
+static double parse_number(const std::string& text) {
+    size_t used = 0;
+    double value = 0.0;
+    try {
+        value = std::stod(text, &used);
+    }
+    catch (const std::exception&) {
+        used = 0;
+    }
+    if (used == 0 || used != text.size() || !std::isfinite(value))
+        throw std::invalid_argument(text);
+    return value;
+}
+
+static std::vector<std::string> split_list(const std::string& text) {
+    std::vector<std::string> items;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ','))
+        if (!item.empty())
+            items.push_back(item);
+    return items;
+}
+
+int main(int argc, char* argv[]) {
+    // Query the machine architecture, or load a fake one with --sysfs-root <dir>
+    // --topology prints what was found and exits
+    // --pool-bench compares the ThreadPool modes and exits
+    // --task-bench checks enqueue/dequeue does not allocate and prints the submit latency, exits non zero on failure
+    // --arena-bench compares the page backends for a Node pool and exits
+    // --pages default|thp|2m|1g picks the page backend for the Node pools
+    // --pool-size SIZE and --frame-size SIZE (bytes, or with a K/M/G suffix) override the compiled in sizes
+    // --lazy-commit skips the startup prefault of the Node pools, each Frame is faulted in on its first lease
+    // --frame-pool-test runs the FramePool acquire/release test instead of the Frame sweeps
+    // --dispatch-test [SKEW] runs every Frame through the FrameDispatcher, Node 0's SKEW (4) times over, instead of the Frame sweeps
+    // --migration-test compares processing Node 0's Frames remotely with migrating them to the consumer first,
+    //   --reuse N[,N..] uses per Frame (1,2,4,8,16), --migrate-after K remote uses before a Frame moves (2),
+    //   --migrate auto|pages|copy how it moves (auto: move the pages, copy if the OS will not)
+    // --pipeline KERNEL@NODE[,KERNEL@NODE..] runs Frames through those stages in order, e.g. fill@0,rmw@1,checksum@0
+    //   for capture -> process -> encode, --pipeline-sweep tries every stage to Node mapping instead,
+    //   --pipeline-frames N (256), --pipeline-lanes N workers per stage (2), --ring N Frames between stages (8)
+    // --coroutine-test [NODES] runs every Frame of the first Node through the kernel on each Node of the list in turn
+    //   (every Node then back to the first by default), as coroutines hopping Nodes and as wait_for_all barriers per step
+    // --stream N|sweep releases N paced streams of Frames (or sweeps N up until deadlines are missed) on one Node,
+    //   --fps F (60), --stream-seconds S per run (2), --deadline F frame periods (1), --stream-buffers N per stream (2),
+    //   --stream-node N (0)
+    // --latency-matrix runs the pointer chase latency and bandwidth matrices instead of the Frame sweeps
+    // --work-stealing runs the tests on WorkStealing pools, --steal-remote also lets them steal across Nodes
+    // --kernel NAME[,NAME..]|all picks the Frame kernels for the tests (fill by default), --kernels lists them
+    // --isa scalar|sse2|avx2|avx512 caps the kernel variant below what the CPU supports
+    // Frame sweep harness:
+    // --loops N passes over the Frames per run (10), --reps N timed runs (5), --warmup N untimed runs first (1)
+    // --scenarios NAME[,NAME..] runs only those, --list-scenarios lists them, --sleep SECONDS pauses between them
+    // --pool-modes interleaved,replicated adds those pools as extra Memory Nodes for the Scenarios (interleaved_all, ...),
+    //   --interleave-nodes N[,N..] picks the Nodes the interleaved pool spreads over (all of them)
+    // --scenario SPEC (repeatable) and --scenario-file FILE (one SPEC per line, # comments) replace the built in
+    //   Scenarios, see ScenarioEngine::parse for the SPEC format, --together runs the selected ones at the same time
+    // --json FILE and --csv FILE write the results, --baseline FILE compares with an earlier --csv file
+    //   and exits with 2 if any median GB/s is more than --tolerance (0.1 = 10%) below it
+    // --telemetry prints the ThreadPool per Frame wait/run percentiles and utilization for each Scenario
+    // --perf counts cycles, instructions, LLC misses, local/remote DRAM loads and dTLB misses on every pool thread
+    //   for each Scenario, into the output and the JSON/CSV files, where the machine allows it
+    // --wait waits for a key before exiting
+    std::string sysfs_root;
+    bool print_topology_only = false;
+    bool pool_bench = false;
+    bool task_bench = false;
+    bool frame_pool_test = false;
+    bool arena_bench = false;
+    bool latency_matrix = false;
+    bool dispatch_test = false;
+    bool migration_test = false;
+    bool stream_test = false;
+    bool coroutine_test = false;
+    std::vector<size_t> coroutine_route;
+    size_t stream_count = 0;
+    StreamOptions stream_options;
+    std::string pipeline_spec;
+    bool pipeline_sweep = false;
+    PipelineOptions pipeline_options;
+    std::vector<size_t> reuse_counts = { 1, 2, 4, 8, 16 };
+    MigrationOptions migration_options;
+    size_t dispatch_skew = 4;
+    bool list_kernels = false;
+    bool list_scenarios = false;
+    bool wait_at_exit = false;
+    std::vector<std::string> scenario_texts;
+    std::vector<std::string> scenario_files;
+    std::vector<PoolPlacement> extra_pools;
+    std::vector<std::string> interleave_nodes;
+    std::string json_path;
+    std::string csv_path;
+    std::string baseline_path;
+    double tolerance = 0.1;
+    AllocatorOptions allocator_options;
+    ThreadPoolOptions pool_options;
+    BenchmarkOptions benchmark_options;
+    // Every numeric option goes through parse_count / parse_number, a bad value stops the run here
+    std::string arg;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            arg = argv[i];
+            bool has_value = i + 1 < argc;
+            if (arg == "--sysfs-root" && has_value)
+                sysfs_root = argv[++i];
+            else if (arg == "--topology")
+                print_topology_only = true;
+            else if (arg == "--pool-bench")
+                pool_bench = true;
+            else if (arg == "--task-bench")
+                task_bench = true;
+            else if (arg == "--frame-pool-test")
+                frame_pool_test = true;
+            else if (arg == "--dispatch-test") {
+                dispatch_test = true;
+                if (has_value && std::isdigit(static_cast<unsigned char>(argv[i + 1][0])))
+                    dispatch_skew = parse_count(argv[++i]);
+            }
+            else if (arg == "--migration-test")
+                migration_test = true;
+            else if (arg == "--reuse" && has_value) {
+                reuse_counts.clear();
+                for (const auto& count : split_list(argv[++i]))
+                    reuse_counts.push_back(parse_count(count));
+            }
+            else if (arg == "--migrate-after" && has_value)
+                migration_options.remote_uses = static_cast<uint32_t>(parse_count(argv[++i]));
+            else if (arg == "--migrate" && has_value) {
+                std::string mode = argv[++i];
+                if (mode == "auto")
+                    migration_options.mode = MigrationMode::Auto;
+                else if (mode == "pages")
+                    migration_options.mode = MigrationMode::MovePages;
+                else if (mode == "copy")
+                    migration_options.mode = MigrationMode::Copy;
+                else {
+                    std::cerr << "Bad --migrate mode: " << mode << std::endl;
+                    return 1;
+                }
+            }
+            else if (arg == "--pipeline" && has_value)
+                pipeline_spec = argv[++i];
+            else if (arg == "--pipeline-sweep")
+                pipeline_sweep = true;
+            else if (arg == "--pipeline-frames" && has_value)
+                pipeline_options.frames = std::max<size_t>(1, parse_count(argv[++i]));
+            else if (arg == "--pipeline-lanes" && has_value)
+                pipeline_options.lanes = std::max<size_t>(1, parse_count(argv[++i]));
+            else if (arg == "--ring" && has_value)
+                pipeline_options.ring_capacity = std::max<size_t>(1, parse_count(argv[++i]));
+            else if (arg == "--coroutine-test") {
+                coroutine_test = true;
+                if (has_value && std::isdigit(static_cast<unsigned char>(argv[i + 1][0]))) {
+                    for (const std::string& node : split_list(argv[++i]))
+                        coroutine_route.push_back(parse_count(node));
+                }
+            }
+            else if (arg == "--stream" && has_value) {
+                stream_test = true;
+                std::string count = argv[++i];
+                stream_count = count == "sweep" ? 0 : std::max<size_t>(1, parse_count(count));
+            }
+            else if (arg == "--fps" && has_value)
+                stream_options.fps = parse_number(argv[++i]);
+            else if (arg == "--stream-seconds" && has_value)
+                stream_options.seconds = parse_number(argv[++i]);
+            else if (arg == "--deadline" && has_value)
+                stream_options.deadline_frames = parse_number(argv[++i]);
+            else if (arg == "--stream-buffers" && has_value)
+                stream_options.buffers = std::max<size_t>(1, parse_count(argv[++i]));
+            else if (arg == "--stream-node" && has_value)
+                stream_options.node = parse_count(argv[++i]);
+            else if (arg == "--latency-matrix")
+                latency_matrix = true;
+            else if (arg == "--arena-bench")
+                arena_bench = true;
+            else if (arg == "--pages" && has_value) {
+                std::string pages = argv[++i];
+                bool found = false;
+                std::string names;
+                for (auto backend : { Platform::PageBackend::Default, Platform::PageBackend::Transparent,
+                    Platform::PageBackend::Huge2MB, Platform::PageBackend::Huge1GB }) {
+                    names += std::string(names.empty() ? "" : ", ") + Platform::page_backend_name(backend);
+                    if (pages == Platform::page_backend_name(backend)) {
+                        allocator_options.backend = backend;
+                        found = true;
+                    }
+                }
+                if (!found) {
+                    std::cerr << "Bad --pages backend: " << pages << ", one of " << names << std::endl;
+                    return 1;
+                }
+            }
+            else if (arg == "--lazy-commit")
+                allocator_options.lazy_commit = true;
+            else if ((arg == "--pool-size" || arg == "--frame-size") && has_value) {
+                size_t bytes = parse_size(argv[++i]);
+                if (bytes == 0) {
+                    std::cerr << "Bad size for " << arg << ": " << argv[i] << std::endl;
+                    return 1;
+                }
+                (arg == "--pool-size" ? allocator_options.pool_size : allocator_options.frame_size) = bytes;
+            }
+            else if (arg == "--kernel" && has_value)
+                benchmark_options.kernels = split_list(argv[++i]);
+            else if (arg == "--kernels")
+                list_kernels = true;
+            else if (arg == "--isa" && has_value) {
+                std::string isa = argv[++i];
+                bool found = false;
+                std::string names;
+                for (auto candidate : { Isa::Scalar, Isa::SSE2, Isa::AVX2, Isa::AVX512 }) {
+                    names += std::string(names.empty() ? "" : ", ") + isa_name(candidate);
+                    if (isa == isa_name(candidate)) {
+                        benchmark_options.max_isa = candidate;
+                        found = true;
+                    }
+                }
+                if (!found) {
+                    std::cerr << "Bad --isa: " << isa << ", one of " << names << std::endl;
+                    return 1;
+                }
+            }
+            else if (arg == "--work-stealing")
+                pool_options.mode = PoolMode::WorkStealing;
+            else if (arg == "--steal-remote") {
+                pool_options.mode = PoolMode::WorkStealing;
+                pool_options.steal_policy = StealPolicy::AllowRemote;
+            }
+            else if (arg == "--loops" && has_value)
+                benchmark_options.loops = parse_count(argv[++i]);
+            else if (arg == "--reps" && has_value)
+                benchmark_options.repetitions = std::max<size_t>(1, parse_count(argv[++i]));
+            else if (arg == "--warmup" && has_value)
+                benchmark_options.warmup = parse_count(argv[++i]);
+            else if (arg == "--scenarios" && has_value)
+                benchmark_options.scenarios = split_list(argv[++i]);
+            else if (arg == "--pool-modes" && has_value) {
+                for (const auto& mode : split_list(argv[++i])) {
+                    if (mode == pool_placement_name(PoolPlacement::Interleaved))
+                        extra_pools.push_back(PoolPlacement::Interleaved);
+                    else if (mode == pool_placement_name(PoolPlacement::Replicated))
+                        extra_pools.push_back(PoolPlacement::Replicated);
+                    else {
+                        std::cerr << "Bad pool mode: " << mode << std::endl;
+                        return 1;
+                    }
+                }
+            }
+            else if (arg == "--interleave-nodes" && has_value)
+                interleave_nodes = split_list(argv[++i]);
+            else if (arg == "--scenario" && has_value)
+                scenario_texts.push_back(argv[++i]);
+            else if (arg == "--scenario-file" && has_value)
+                scenario_files.push_back(argv[++i]);
+            else if (arg == "--together")
+                benchmark_options.together = true;
+            else if (arg == "--list-scenarios")
+                list_scenarios = true;
+            else if (arg == "--sleep" && has_value)
+                benchmark_options.sleep_seconds = parse_number(argv[++i]);
+            else if (arg == "--json" && has_value)
+                json_path = argv[++i];
+            else if (arg == "--csv" && has_value)
+                csv_path = argv[++i];
+            else if (arg == "--baseline" && has_value)
+                baseline_path = argv[++i];
+            else if (arg == "--tolerance" && has_value)
+                tolerance = parse_number(argv[++i]);
+            else if (arg == "--telemetry")
+                benchmark_options.telemetry = true;
+            else if (arg == "--perf")
+                benchmark_options.perf = true;
+            else if (arg == "--wait")
+                wait_at_exit = true;
+            else {
+                std::cerr << "Unknown option: " << arg << std::endl;
+                return 1;
+            }
+        }
+    }
+    catch (const std::invalid_argument& error) {
+        std::cerr << "Bad value for " << arg << ": " << error.what() << std::endl;
+        return 1;
+    }
+
+    const KernelRegistry& kernels = KernelRegistry::instance();
+    if (list_kernels) {
+        std::cout << "CPU ISA: " << isa_name(kernels.get_cpu_isa()) << "\n";
+        for (const auto& name : kernels.names())
+            std::cout << "    " << name << " (" << isa_name(kernels.find(name, benchmark_options.max_isa)->isa) << ")\n";
+        return 0;
+    }
+    if (benchmark_options.kernels.size() == 1 && benchmark_options.kernels[0] == "all")
+        benchmark_options.kernels = kernels.names();
 
-    // Define the affinity masks for each node
-    // TODO - Dynamic calc the affinity masks based on Node and Cores/Node
-    std::vector<DWORD_PTR> affinity_masks = {
-        0xFFFFFF,          // Affinity mask for first 24 cores
-        0xFFFFFF000000,    // Affinity mask for cores 2447
-    };
+    // Read the baseline up front so a bad path fails before the long run
+    std::vector<ScenarioStats> baseline;
+    if (!baseline_path.empty() && !BenchmarkReport::read_csv(baseline_path, baseline)) {
+        std::cerr << "Can not read baseline: " << baseline_path << std::endl;
+        return 1;
+    }
+
+    Topology topology = sysfs_root.empty() ? Topology::discover() : Topology::from_sysfs(sysfs_root);
+    topology.print(std::cout);
+    if (print_topology_only)
+        return 0;
+
+    // Interleave set as Topology indices on the command line, OS Node numbers for the allocator
+    for (const auto& index : interleave_nodes) {
+        std::vector<size_t> node;
+        if (!ScenarioEngine::parse_nodes(index, topology.num_nodes(), node) || node.size() != 1) {
+            std::cerr << "Bad --interleave-nodes entry: " << index << std::endl;
+            return 1;
+        }
+        allocator_options.interleave_nodes.push_back(topology.get_nodes()[node.front()].id);
+    }
+    std::vector<std::string> extra_memory;
+    for (PoolPlacement placement : extra_pools)
+        extra_memory.push_back(pool_placement_name(placement));
+
+    // Scenario specs name Topology indices, so they are checked against the Nodes found
+    for (const auto& path : scenario_files) {
+        std::ifstream file(path);
+        if (!file) {
+            std::cerr << "Can not read scenario file: " << path << std::endl;
+            return 1;
+        }
+        std::string line;
+        while (std::getline(file, line)) {
+            line = line.substr(0, line.find('#'));
+            line.erase(std::remove_if(line.begin(), line.end(), [](unsigned char c) { return std::isspace(c); }), line.end());
+            if (!line.empty())
+                scenario_texts.push_back(line);
+        }
+    }
+    std::vector<ScenarioSpec> scenario_specs;
+    for (const auto& text : scenario_texts) {
+        ScenarioSpec spec;
+        std::string error;
+        if (!ScenarioEngine::parse(text, topology.num_nodes(), spec, error, extra_memory)) {
+            std::cerr << "Bad scenario: " << error << std::endl;
+            return 1;
+        }
+        if (ScenarioEngine::expand(spec, topology.num_nodes(), extra_memory).empty()) {
+            std::cerr << "Bad scenario: '" << text << "' has nothing to run on this machine" << std::endl;
+            return 1;
+        }
+        scenario_specs.push_back(spec);
+    }
+
+    if (pool_bench) {
+        PoolBenchmark(topology).run();
+        return 0;
+    }
+
+    if (arena_bench) {
+        ArenaBenchmark(topology, 0, allocator_options).run();
+        return 0;
+    }
+
+    if (task_bench) {
+        PoolBenchmark benchmark(topology);
+        benchmark.run_submit_latency();
+        return benchmark.run_allocation_check() ? 0 : 1;
+    }
+
+    int exit_code = 0;
 
     // Run the tests and Deallocate the Memory
     {
         // Create the NodeManager
-        NodeManager node_manager(num_nodes, num_cores_per_node, affinity_masks);
+        // One ThreadPool thread per logical CPU in each Node
+        NodeManager node_manager(topology, pool_options, allocator_options, extra_pools);
+        if (!scenario_specs.empty())
+            node_manager.set_scenario_specs(scenario_specs);
 
-        // Run the tests
-        // TODO : Make this Cmd Line Params
-        size_t nLoops = 10;     // Test the whole pool n times
-        bool withSleep = false; // sleep for 5 seconds between tests for Profiling to separate the blocks
-        node_manager.run_tests(nLoops, withSleep);
+        if (list_scenarios) {
+            for (const auto& scenario : node_manager.get_scenarios()) {
+                std::cout << "    " << scenario.name << (scenario.concurrency == Concurrency::Sequential ? " (sequential)" : "") << ":";
+                for (const auto& run : scenario.runs) {
+                    std::cout << " " << ScenarioEngine::memory_name(run.memory_node, topology.num_nodes(), extra_memory) << ">" << run.thread_node;
+                    if (run.first || run.stride != 1)
+                        std::cout << "[" << run.first << "::" << run.stride << "]";
+                    if (run.count)
+                        std::cout << "x" << run.count;
+                }
+                std::cout << "\n";
+            }
+            return 0;
+        }
 
-        // Print the durations
-        // TODO - Batch Mode Results?
-        // node_manager.print_durations();
+        if (frame_pool_test)
+            node_manager.run_frame_pool_test(1000000);
+        else if (!pipeline_spec.empty() || pipeline_sweep) {
+            std::vector<PipelineStage> stages;
+            for (const auto& item : split_list(pipeline_spec.empty() ? "fill@0,rmw@0,checksum@0" : pipeline_spec)) {
+                const size_t at = item.find('@');
+                PipelineStage stage;
+                stage.name = item.substr(0, at);
+                const auto* kernel = kernels.find(stage.name, benchmark_options.max_isa);
+                std::vector<size_t> node;
+                if (!kernel || (at != std::string::npos && (!ScenarioEngine::parse_nodes(item.substr(at + 1), topology.num_nodes(), node) || node.size() != 1))) {
+                    std::cerr << "Bad pipeline stage: " << item << ", KERNEL@NODE with a kernel from --kernels" << std::endl;
+                    return 1;
+                }
+                stage.kernel = kernel->kernel;
+                stage.node = node.empty() ? 0 : node.front();
+                stages.push_back(stage);
+            }
+            if (pipeline_sweep)
+                node_manager.run_pipeline_sweep(stages, pipeline_options);
+            else
+                Pipeline::print(node_manager.run_pipeline(stages, pipeline_options), std::cout);
+        }
+        else if (dispatch_test || migration_test || stream_test || coroutine_test || latency_matrix) {
+            const auto* kernel = kernels.find(benchmark_options.kernels.front(), benchmark_options.max_isa);
+            if (!kernel) {
+                std::cerr << "Unknown kernel: " << benchmark_options.kernels.front() << ", --kernels lists them" << std::endl;
+                return 1;
+            }
+            node_manager.set_kernel(kernel->kernel);
+            if (dispatch_test)
+                node_manager.run_dispatch_test(benchmark_options.loops, dispatch_skew);
+            else if (migration_test)
+                node_manager.run_migration_test(reuse_counts, migration_options);
+            else if (stream_test)
+                node_manager.run_stream_test(stream_count, stream_options);
+            else if (coroutine_test) {
+                if (coroutine_route.empty()) {
+                    for (size_t node = 0; node < topology.num_nodes(); ++node)
+                        coroutine_route.push_back(node);
+                    coroutine_route.push_back(0);
+                }
+                node_manager.run_coroutine_test(coroutine_route, benchmark_options.loops);
+            }
+            else
+                node_manager.run_latency_matrix();
+        }
+        else {
+            BenchmarkHarness harness(node_manager, benchmark_options);
+            if (!harness.validate(std::cerr))
+                return 1;
+            std::vector<ScenarioStats> results = harness.run();
+
+            RunInfo info;
+            info.host = Platform::host_name();
+            info.cpu_isa = isa_name(kernels.get_cpu_isa());
+            info.pool_mode = pool_options.mode == PoolMode::WorkStealing ? "work_stealing" : "shared_queue";
+            info.pages = Platform::page_backend_name(allocator_options.backend);
+            info.nodes = topology.num_nodes();
+            info.cpus = topology.num_cpus();
+            info.pool_size = allocator_options.pool_size;
+            info.frame_size = allocator_options.frame_size;
+            info.loops = benchmark_options.loops;
+            info.repetitions = benchmark_options.repetitions;
+            info.warmup = benchmark_options.warmup;
+
+            if (!json_path.empty() && !BenchmarkReport::write_json(json_path, info, results)) {
+                std::cerr << "Can not write " << json_path << std::endl;
+                exit_code = 1;
+            }
+            if (!csv_path.empty() && !BenchmarkReport::write_csv(csv_path, results)) {
+                std::cerr << "Can not write " << csv_path << std::endl;
+                exit_code = 1;
+            }
+            if (!baseline_path.empty() && !BenchmarkReport::compare(results, baseline, tolerance, std::cout))
+                exit_code = 2;
+        }
     }
 
-    std::cout << "Done: Press any key to exit!" << std::endl;
-    _getch();
+    if (wait_at_exit) {
+        std::cout << "Done: Press any key to exit!" << std::endl;
+        Platform::wait_for_key();
+    }
 
-    return 0;
+    return exit_code;
 }
-
@@ -3,227 +3,627 @@
 
 #include <vector>
 #include <memory>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <random>
 #include "MemoryAllocator.h"
+#include "Coroutine.h"
+#include "ReplicatedPool.h"
+#include "StreamBenchmark.h"
+#include "FrameDispatcher.h"
+#include "FramePool.h"
+#include "FrameKernels.h"
+#include "FrameMigration.h"
+#include "LatencyProbe.h"
+#include "Pipeline.h"
+#include "Scenario.h"
 #include "ThreadPool.h"
+#include "Topology.h"
 #include "Constants.h"
 
+struct LatencyOptions {
+    std::vector<size_t> working_sets = { 16 * 1024, 256 * 1024, 4 * 1024 * 1024, 32 * 1024 * 1024, 256 * 1024 * 1024 };
+    size_t loads = 1 << 22;     // Dependent loads timed per measurement
+    bool loaded = true;         // Repeat the largest working set with every other pool thread running the kernel
+};
+
 // Class to manage the Nodes and the Threads and all the tests
 class NodeManager {
 public:
-    NodeManager(size_t num_nodes, size_t num_threads_per_node, const std::vector<DWORD_PTR>& affinity_masks)
-        : num_nodes(num_nodes) {
-        // Allocate the MemoryAllocator for each Node
+    // Size everything from the Topology, pool_options.num_threads of 0 uses every CPU in each Node
+    // extra_placements adds Interleaved / Replicated pools as Memory Nodes num_nodes, num_nodes + 1, ... for the Scenarios
+    NodeManager(const Topology& topology, const ThreadPoolOptions& pool_options = {},
+        const AllocatorOptions& allocator_options = {}, const std::vector<PoolPlacement>& extra_placements = {})
+        : topology(topology), num_nodes(topology.num_nodes()) {
+        // Allocate the MemoryAllocator for each Node, the memory is bound to the Node explicitly
+        // Every Node builds at once from its own CPUs, so startup takes about as long as one Node's prefault
+        AllocatorOptions node_options = allocator_options;
+        node_options.interleave_nodes.clear();
+        std::cout << "Creating MemoryAllocators for " << num_nodes << " Nodes" << (node_options.lazy_commit ? ", lazy commit" : "") << std::endl;
+        auto start = std::chrono::high_resolution_clock::now();
+        allocators = create_node_allocators(this->topology, node_options);
+        std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - start;
+        double slowest = 0.0;
         for (size_t i = 0; i < num_nodes; ++i) {
-            std::cout << "Creating MemoryAllocator Node: " << i << std::endl;
-            allocators.emplace_back(std::make_unique<MemoryAllocator>(affinity_masks[i]));
+            const StartupPhases& phases = allocators[i]->get_startup_phases();
+            slowest = std::max(slowest, phases.total);
+            std::cout << "    Node: " << topology.get_nodes()[i].id << " Pages: " << Platform::page_backend_name(allocators[i]->get_backend())
+                << " Frames: " << allocators[i]->getFrames().size() << std::fixed << std::setprecision(4)
+                << " Map: " << phases.map << " s Prefault: " << phases.prefault << " s";
+            if (!allocators[i]->is_lazy() && phases.prefault > 0.0)
+                std::cout << std::setprecision(2) << " (" << allocators[i]->get_buffer_size() / phases.prefault / 1e9 << " GB/s)";
+            std::cout << std::setprecision(4) << " Carve: " << phases.carve << " s Total: " << phases.total << " s" << std::endl;
         }
+        std::cout << "    Startup: " << duration.count() << " s, slowest Node " << slowest << " s" << std::defaultfloat << std::endl;
+
+        // Interleaved pools spread allocator_options.pool_size over the interleave set (every Node by default),
+        // replicated pools give each Node pool_size / num_nodes so the copies together weigh one Node pool
+        for (PoolPlacement placement : extra_placements) {
+            ExtraPool extra;
+            extra.placement = placement;
+            AllocatorOptions extra_options = allocator_options;
+            if (placement == PoolPlacement::Interleaved) {
+                if (extra_options.interleave_nodes.empty()) {
+                    for (const auto& node : topology.get_nodes())
+                        extra_options.interleave_nodes.push_back(node.id);
+                }
+                CpuSet cpus;
+                for (const auto& node : topology.get_nodes())
+                    cpus |= node.cpus;
+                std::cout << "Creating interleaved MemoryAllocator over " << extra_options.interleave_nodes.size() << " Nodes" << std::endl;
+                extra.interleaved = std::make_unique<MemoryAllocator>(extra_options.interleave_nodes.front(), cpus, extra_options);
+            }
+            else if (placement == PoolPlacement::Replicated) {
+                extra_options.pool_size = std::max(extra_options.frame_size, extra_options.pool_size / num_nodes);
+                std::cout << "Creating replicated MemoryAllocators, one per Node" << std::endl;
+                extra.replicated = std::make_unique<ReplicatedPool>(this->topology, extra_options);
+            }
+            else
+                continue;
+            extra_pools.push_back(std::move(extra));
+        }
+        scenario_specs = ScenarioEngine::default_specs(num_nodes, get_extra_memory_names());
+
+        // Check out / give back access to every Frame, node local first
+        frame_pool = std::make_unique<FramePool>(allocators, topology);
 
         // Allocate the ThreadPool for each Node
-        // NOTE: Using SetProcessAffinityMask for the allocs in MemoryAllocator will override the SetThreadAffinityMask for the threads, do them separately
         for (size_t i = 0; i < num_nodes; ++i) {
-            std::cout << "Creating ThreadPool Node: " << i << std::endl;
-            thread_pools.emplace_back(std::make_unique<ThreadPool>(num_threads_per_node, affinity_masks[i]));
+            std::cout << "Creating ThreadPool Node: " << topology.get_nodes()[i].id << std::endl;
+            thread_pools.emplace_back(std::make_unique<ThreadPool>(topology, i, pool_options));
+            std::cout << "    Threads: " << thread_pools.back()->get_num_threads() << " CPUs: " << topology.get_nodes()[i].cpus << std::endl;
         }
+
+        // Let idle WorkStealing threads fall back to the nearest Nodes when the policy allows it
+        for (size_t i = 0; i < num_nodes; ++i) {
+            std::vector<ThreadPool*> remote_pools;
+            for (size_t other : topology.nodes_by_distance(i))
+                remote_pools.push_back(thread_pools[other].get());
+            thread_pools[i]->set_remote_pools(remote_pools);
+        }
+
+        // Route work by where its buffer lives rather than by a Thread Node the caller picked
+        dispatcher = std::make_unique<FrameDispatcher>(this->topology, allocators, thread_pools);
     }
 
-    // Run all the tests
-    void run_tests(size_t nLoops, bool withSleep) {
+    ~NodeManager() {
+        // Pools may steal from each other, stop them all before any is destroyed
+        for (auto& pool : thread_pools)
+            pool->shutdown();
+    }
 
-        // Run Each Memory node against Each Thread node
-        // Give BEST and WORST cases for Every combination
-        for (size_t memoryNode = 0; memoryNode < num_nodes; ++memoryNode) {
-            for (size_t threadNode = 0; threadNode < num_nodes; ++threadNode) {
+    // Every Scenario the specs expand to on this machine, in spec order
+    std::vector<Scenario> get_scenarios() const {
+        std::vector<Scenario> scenarios;
+        for (const ScenarioSpec& spec : scenario_specs) {
+            for (Scenario& scenario : ScenarioEngine::expand(spec, num_nodes, get_extra_memory_names()))
+                scenarios.push_back(std::move(scenario));
+        }
+        return scenarios;
+    }
 
-                std::cout << "Testing Memory Node: " << memoryNode << " with Thread Node: " << threadNode;
+    // Names of the extra pools, in Memory Node order after the Topology Nodes
+    std::vector<std::string> get_extra_memory_names() const {
+        std::vector<std::string> names;
+        for (const auto& extra : extra_pools)
+            names.push_back(pool_placement_name(extra.placement));
+        return names;
+    }
 
-                // Run Every Frame from memoryNode on threadNode - do it nLoops times
-                auto start = std::chrono::high_resolution_clock::now();
-                for (size_t nLoop = 0; nLoop < nLoops; ++nLoop) {
-                    for (auto frame : allocators[memoryNode]->getFrames()) {
-                        thread_pools[threadNode]->enqueue([frame]() {
-                            process_frame(frame, FRAME_SIZE);
-                            });
-                    }
-                }
+    // Replace the specs get_scenarios expands, ScenarioEngine::default_specs() until told otherwise
+    void set_scenario_specs(const std::vector<ScenarioSpec>& specs) {
+        scenario_specs = specs;
+    }
 
-                // Wait for all threadNodes to finish
-                thread_pools[threadNode]->wait_for_all();
+    const std::vector<ScenarioSpec>& get_scenario_specs() const {
+        return scenario_specs;
+    }
 
-                // Measure the Duration
-                auto end = std::chrono::high_resolution_clock::now();
-                std::chrono::duration<double> duration = end - start;
-                durations.push_back(duration);
-                std::cout << " Duration: " << duration.count() << std::endl;
+    // Submit the runs of the Scenario, nLoops passes over each run's Frames, and wait for all of them
+    // Concurrency::Sequential waits for each run before submitting the next, the time covers them all
+    ScenarioTiming run_scenario(const Scenario& scenario, size_t nLoops) {
+        ScenarioTiming timing;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (const ScenarioRun& run : scenario.runs) {
+            timing.bytes += nLoops * submit_frames(run, nLoops) * memory_for(run.memory_node, run.thread_node).get_frame_size();
+            if (scenario.concurrency == Concurrency::Sequential)
+                thread_pools[run.thread_node]->wait_for_all();
+        }
+
+        // Wait for all the Thread Nodes to finish
+        for (size_t threadNode = 0; threadNode < num_nodes; ++threadNode)
+            thread_pools[threadNode]->wait_for_all();
+
+        std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - start;
+        timing.seconds = duration.count();
+        return timing;
+    }
 
-                if (withSleep) {
-                    std::this_thread::sleep_for(std::chrono::seconds(5));
+    // Acquire/release throughput of the FramePool from each Node's own threads, then drain Node 0
+    // one Frame past empty to show the remote fallback being counted
+    void run_frame_pool_test(size_t ops_per_thread) {
+        for (size_t node = 0; node < num_nodes; ++node) {
+            const size_t threads = thread_pools[node]->get_num_threads();
+            auto start = std::chrono::high_resolution_clock::now();
+            thread_pools[node]->parallel_for(0, threads, 1, [this, node, ops_per_thread](size_t) {
+                for (size_t op = 0; op < ops_per_thread; ++op) {
+                    FrameLease lease = frame_pool->acquire(node);
+                    if (lease)
+                        lease.data()[0] = std::byte{ 0xAA };
                 }
-            }
+                // The workers live on, their cached Frames go back so the drain below can reach them
+                frame_pool->flush();
+                });
+            thread_pools[node]->wait_for_all();
+            std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - start;
+            std::cout << "FramePool Node " << node << ": " << threads * ops_per_thread / duration.count() / 1e6
+                << " million acquire+release/s with " << threads << " threads" << std::endl;
         }
 
-        // Run Every Memory node against every Thread node
-        // Give General case when everything is running 
-        // Total WORST case Performance
-        std::cout << "Testing ALL Nodes GENERAL: ";
         {
-            // Run Each Memory node against Each Thread node
-            auto start = std::chrono::high_resolution_clock::now();
-            for (size_t memoryNode = 0; memoryNode < num_nodes; ++memoryNode) {
-                for (size_t threadNode = 0; threadNode < num_nodes; ++threadNode) {
-
-                    // Run Every Frame from memoryNode on threadNode - do it nLoops times
-                    for (size_t nLoop = 0; nLoop < nLoops; ++nLoop) {
-                        for (auto frame : allocators[memoryNode]->getFrames()) {
-                            thread_pools[threadNode]->enqueue([frame]() {
-                                process_frame(frame, FRAME_SIZE);
-                                });
-                        }
-                    }
+            std::vector<FrameLease> held;
+            const size_t local_frames = allocators[0]->getFrames().size();
+            for (size_t i = 0; i <= local_frames; ++i)
+                held.push_back(frame_pool->acquire(0));
+            std::cout << "FramePool Node 0 drained: ";
+            if (held.back())
+                std::cout << "last lease from Node " << held.back().get_node() << std::endl;
+            else
+                std::cout << "last acquire failed, every Node is dry" << std::endl;
+        }
+
+        for (size_t node = 0; node < num_nodes; ++node) {
+            auto stats = frame_pool->get_stats(node);
+            std::cout << "FramePool Node " << node << " local: " << stats.local_acquires << " remote fallbacks: "
+                << stats.remote_fallbacks << " failed: " << stats.failed_acquires << std::endl;
+        }
+    }
+
+    // Every Frame of every Node nLoops times, Node 0's skew times over, in a shuffled order through the FrameDispatcher,
+    // once with spilling to nearer Nodes and once with every Frame held to its home Node
+    // Nobody picks a Thread Node, the dispatcher finds each Frame's home, which is the ALL Node BEST placement
+    // until Node 0's pool backs up and the extra work spills
+    void run_dispatch_test(size_t nLoops, size_t skew) {
+        for (size_t node = 0; node < num_nodes; ++node) {
+            const auto& frames = allocators[node]->getFrames();
+            if (frames.empty())
+                continue;
+            const int os_node = Platform::page_node(frames.front());
+            std::cout << "Dispatch Node " << node << ": pool range -> Node " << dispatcher->home_node(frames.front())
+                << ", OS reports the first Frame on OS Node " << (os_node < 0 ? std::string("unknown") : std::to_string(os_node))
+                << " (expected " << topology.get_nodes()[node].id << ")" << std::endl;
+        }
+
+        std::vector<std::pair<std::byte*, size_t>> work;
+        for (size_t loop = 0; loop < nLoops; ++loop) {
+            for (size_t node = 0; node < num_nodes; ++node) {
+                for (size_t repeat = 0; repeat < (node == 0 ? std::max<size_t>(1, skew) : 1); ++repeat) {
+                    for (std::byte* frame : allocators[node]->getFrames())
+                        work.push_back({ frame, allocators[node]->get_frame_size() });
                 }
             }
+        }
+        std::shuffle(work.begin(), work.end(), std::mt19937_64(0x5EED));
+
+        DispatcherOptions home_only;
+        home_only.spill_depth = SIZE_MAX;
+        FrameDispatcher pinned(topology, allocators, thread_pools, home_only);
+        for (FrameDispatcher* pass : { dispatcher.get(), &pinned }) {
+            pass->reset_stats();
+            uint64_t bytes = 0;
+            auto start = std::chrono::high_resolution_clock::now();
+            for (const auto& [frame, frame_size] : work) {
+                pass->dispatch(frame, [frame, frame_size, frame_kernel = kernel]() { frame_kernel(frame, frame_size); });
+                bytes += frame_size;
+            }
+            for (auto& pool : thread_pools)
+                pool->wait_for_all();
+            std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - start;
+
+            std::cout << (pass == &pinned ? "Dispatch home only: " : "Dispatch with spill: ") << std::fixed << std::setprecision(4)
+                << duration.count() << " s " << std::setprecision(2) << bytes / duration.count() / 1e9 << " GB/s" << std::endl;
+            for (size_t node = 0; node < num_nodes; ++node) {
+                FrameDispatcher::Stats stats = pass->get_stats(node);
+                std::cout << "    Node " << node << " local: " << stats.local << " spilled: " << stats.spilled
+                    << " unknown: " << stats.unknown;
+                if (pass != &pinned)
+                    std::cout << " (spill depth " << pass->get_spill_depth(node) << ")";
+                std::cout << std::endl;
+            }
+        }
+    }
 
-            // Wait for all threads to finish
-            for (size_t threadNode = 0; threadNode < num_nodes; ++threadNode)
+    // Migrate-then-process against process-remotely, for a consumer that has drifted to the nearest other Node
+    // Up to 32 of Node 0's Frames are run through the kernel reuse times over on that Node's threads:
+    // once left where they are, once through a FrameMigrator that moves each Frame after migration_options.remote_uses uses
+    // The migrated run's time includes the moves, the Frames go home again between runs
+    void run_migration_test(const std::vector<size_t>& reuse_counts, const MigrationOptions& migration_options) {
+        if (num_nodes < 2) {
+            std::cout << "Migration test: needs at least two Nodes" << std::endl;
+            return;
+        }
+        const size_t memoryNode = 0;
+        const size_t threadNode = topology.nodes_by_distance(memoryNode).front();
+        const auto& all_frames = allocators[memoryNode]->getFrames();
+        const std::vector<std::byte*> frames(all_frames.begin(), all_frames.begin() + std::min<size_t>(32, all_frames.size() / 2));
+        const size_t frame_size = allocators[memoryNode]->get_frame_size();
+        std::cout << "Migration test: " << frames.size() << " Frames of Node " << memoryNode << " consumed on Node " << threadNode
+            << ", migrate after " << migration_options.remote_uses << " remote uses" << std::endl;
+        std::cout << std::setw(8) << "Reuse" << std::setw(12) << "Remote s" << std::setw(12) << "Migrate s" << std::setw(12) << "Moving s"
+            << std::setw(10) << "Speedup" << std::setw(8) << "Moved" << std::setw(8) << "Failed" << std::setw(10) << "Pages" << std::setw(12) << "Copied MB" << "\n";
+
+        for (size_t reuse : reuse_counts) {
+            auto start = std::chrono::high_resolution_clock::now();
+            for (size_t pass = 0; pass < reuse; ++pass) {
+                thread_pools[threadNode]->parallel_for(0, frames.size(), 1, [&frames, frame_size, frame_kernel = kernel](size_t index) {
+                    frame_kernel(frames[index], frame_size);
+                    });
+                thread_pools[threadNode]->wait_for_all();
+            }
+            std::chrono::duration<double> remote = std::chrono::high_resolution_clock::now() - start;
+
+            FrameMigrator migrator(topology, allocators, *frame_pool, migration_options);
+            start = std::chrono::high_resolution_clock::now();
+            for (size_t pass = 0; pass < reuse; ++pass) {
+                thread_pools[threadNode]->parallel_for(0, frames.size(), 1, [&frames, &migrator, threadNode, frame_size, frame_kernel = kernel](size_t index) {
+                    frame_kernel(migrator.consume(frames[index], threadNode), frame_size);
+                    });
                 thread_pools[threadNode]->wait_for_all();
+            }
+            std::chrono::duration<double> migrated = std::chrono::high_resolution_clock::now() - start;
+            FrameMigrator::Stats stats = migrator.get_stats();
+            migrator.restore();
+
+            std::cout << std::fixed << std::setw(8) << reuse << std::setprecision(4) << std::setw(12) << remote.count()
+                << std::setw(12) << migrated.count() << std::setw(12) << stats.seconds << std::setprecision(2)
+                << std::setw(10) << remote.count() / migrated.count() << std::setw(8) << stats.migrations << std::setw(8) << stats.failed
+                << std::setw(10) << stats.pages_moved << std::setw(12) << stats.bytes_copied / 1048576.0 << std::endl;
+        }
+    }
 
-            // Measure the Duration
-            auto end = std::chrono::high_resolution_clock::now();
-            std::chrono::duration<double> duration = end - start;
-            durations.push_back(duration);
-            std::cout << " Duration: " << duration.count() << std::endl;
+    // Push pipeline_options.frames through the stages, Frames leased from the first stage's Node
+    PipelineResult run_pipeline(const std::vector<PipelineStage>& stages, PipelineOptions pipeline_options) {
+        if (stages.empty())
+            return {};
+        pipeline_options.frame_size = allocators[stages.front().node]->get_frame_size();
+        return Pipeline(topology, *frame_pool, stages, pipeline_options).run();
+    }
 
-            if (withSleep)
-                std::this_thread::sleep_for(std::chrono::seconds(5));
+    // Every stage to Node mapping (num_nodes ^ stages of them), fastest first, to find where each stage should run
+    // The stages' own nodes are ignored
+    void run_pipeline_sweep(std::vector<PipelineStage> stages, const PipelineOptions& pipeline_options) {
+        std::vector<std::pair<double, std::string>> rows;
+        size_t mappings = 1;
+        for (size_t s = 0; s < stages.size(); ++s)
+            mappings *= num_nodes;
+        for (size_t mapping = 0; mapping < mappings; ++mapping) {
+            std::string name;
+            for (size_t s = 0, rest = mapping; s < stages.size(); ++s, rest /= num_nodes) {
+                stages[s].node = rest % num_nodes;
+                name += (s ? "," : "") + stages[s].name + "@" + std::to_string(stages[s].node);
+            }
+            PipelineResult result = run_pipeline(stages, pipeline_options);
+            rows.push_back({ result.seconds > 0.0 ? result.frames / result.seconds : 0.0, name });
         }
+        std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+        std::cout << "Pipeline mappings, fastest first\n";
+        for (const auto& [fps, name] : rows)
+            std::cout << std::fixed << std::setprecision(1) << std::setw(10) << fps << " fps  " << name << "\n";
+        std::cout << std::flush;
+    }
 
-        // Run Each Memory node against every Thread node
-        // Give WORST case Per Memory Node 
-        {
-            // Run Each Memory node against Each Thread node
-            for (size_t memoryNode = 0; memoryNode < num_nodes; ++memoryNode) {
-
-                std::cout << "Testing Memory Node " << memoryNode << " against ALL Thread Nodes: ";
-
-                auto start = std::chrono::high_resolution_clock::now();
-                for (size_t threadNode = 0; threadNode < num_nodes; ++threadNode) {
-
-                    // Run Every Frame from memoryNode on threadNode - do it nLoops times
-                    for (size_t nLoop = 0; nLoop < nLoops; ++nLoop) {
-                        for (auto frame : allocators[memoryNode]->getFrames()) {
-                            thread_pools[threadNode]->enqueue([frame]() {
-                                process_frame(frame, FRAME_SIZE);
-                                });
-                        }
-                    }
-                }
+    // Awaitable that moves a coroutine onto the Node's (Topology index) ThreadPool: co_await node_manager.schedule_on(node)
+    ThreadPool::ScheduleAwaiter schedule_on(size_t node) {
+        return thread_pools[std::min(node, num_nodes - 1)]->schedule();
+    }
 
-                // Wait for all threads to finish
-                for (size_t threadNode = 0; threadNode < num_nodes; ++threadNode)
-                    thread_pools[threadNode]->wait_for_all();
+    // Multi step Frame jobs: every Frame of the route's first Node runs the kernel once on each Node of the route in turn
+    // As coroutines each Frame hops Nodes on its own and one sync_wait covers them all,
+    // the barrier version runs a step for every Frame and waits for the whole pool before the next step
+    void run_coroutine_test(const std::vector<size_t>& route, size_t nLoops) {
+        if (route.empty())
+            return;
+        const size_t memory_node = std::min(route.front(), num_nodes - 1);
+        const auto& frames = allocators[memory_node]->getFrames();
+        const size_t frame_size = allocators[memory_node]->get_frame_size();
+        std::cout << "Frame jobs: " << frames.size() << " Frames of Node " << memory_node << ", route";
+        for (size_t node : route)
+            std::cout << " " << std::min(node, num_nodes - 1);
+        std::cout << ", " << nLoops << " loops" << std::endl;
+
+        auto coroutines = [&]() {
+            std::vector<CoTask<uint64_t>> jobs;
+            for (std::byte* frame : frames)
+                jobs.push_back(frame_job(frame, frame_size, route));
+            uint64_t bytes = 0;
+            for (uint64_t job_bytes : sync_wait(when_all(std::move(jobs))))
+                bytes += job_bytes;
+            return bytes;
+        };
+        auto barriers = [&]() {
+            uint64_t bytes = 0;
+            for (size_t node : route) {
+                ThreadPool& pool = *thread_pools[std::min(node, num_nodes - 1)];
+                for (std::byte* frame : frames)
+                    pool.enqueue([frame, frame_size, frame_kernel = kernel]() { frame_kernel(frame, frame_size); });
+                pool.wait_for_all();
+                bytes += frames.size() * frame_size;
+            }
+            return bytes;
+        };
 
-                // Measure the Duration
-                auto end = std::chrono::high_resolution_clock::now();
-                std::chrono::duration<double> duration = end - start;
-                durations.push_back(duration);
-                std::cout << " Duration: " << duration.count() << std::endl;
+        auto report = [nLoops](const char* name, auto& pass) {
+            uint64_t bytes = 0;
+            auto start = std::chrono::high_resolution_clock::now();
+            for (size_t loop = 0; loop < nLoops; ++loop)
+                bytes += pass();
+            std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - start;
+            std::cout << name << std::fixed << std::setprecision(4) << duration.count() << " s " << std::setprecision(2)
+                << bytes / duration.count() / 1e9 << " GB/s" << std::defaultfloat << std::endl;
+        };
+        report("Coroutines: ", coroutines);
+        report("Barriers:   ", barriers);
+    }
 
-                if (withSleep)
-                    std::this_thread::sleep_for(std::chrono::seconds(5));
-            }
+    // Paced live streams on stream_options.node's pool with the current kernel, num_streams of them,
+    // or 0 to sweep the stream count up until the deadlines fail
+    void run_stream_test(size_t num_streams, const StreamOptions& stream_options) {
+        const size_t node = std::min(stream_options.node, num_nodes - 1);
+        StreamOptions options = stream_options;
+        options.node = node;
+        std::cout << "Streams on Node " << node << ": " << options.fps << " fps, " << options.seconds << " s per run, deadline "
+            << options.deadline_frames << " frame periods, " << options.buffers << " buffers per stream, "
+            << thread_pools[node]->get_num_threads() << " threads" << std::endl;
+        StreamBenchmark benchmark(*frame_pool, *thread_pools[node], kernel, allocators[node]->get_frame_size(), options);
+        if (num_streams == 0) {
+            benchmark.sweep(std::cout);
+            return;
+        }
+        StreamResult result = benchmark.run(num_streams);
+        if (result.out_of_frames) {
+            std::cout << "Out of Frames on Node " << node << " for " << num_streams << " streams" << std::endl;
+            return;
         }
+        StreamBenchmark::print_header(std::cout);
+        StreamBenchmark::print(result, std::cout);
+    }
 
-        // Run Each Memory node against it own Thread node
-        // Give BEST case when ALL Cores running
-        std::cout << "Testing ALL Node BEST: ";
-        {
-            // Run Each Memory node against the same Thread node
-            auto start = std::chrono::high_resolution_clock::now();
-            for (size_t memoryNode = 0; memoryNode < num_nodes; ++memoryNode) {
-
-                // Thread and Memory are the same node (BEST case)
-                auto threadNode = memoryNode;
-
-                // Run Every Frame from memoryNode on threadNode - do it nLoops times
-                for (size_t nLoop = 0; nLoop < nLoops; ++nLoop) {
-                    for (auto frame : allocators[memoryNode]->getFrames()) {
-                        thread_pools[threadNode]->enqueue([frame]() {
-                            process_frame(frame, FRAME_SIZE);
-                            });
-                    }
-                }
-            }
+    // Kernel run on every Frame by run_scenario, fill (the original std::fill) until told otherwise
+    void set_kernel(FrameKernel frame_kernel) {
+        kernel = frame_kernel;
+    }
 
-            // Wait for all threads to finish
-            for (size_t threadNode = 0; threadNode < num_nodes; ++threadNode)
-                thread_pools[threadNode]->wait_for_all();
+    // Pointer chase latency for every Memory Node x Thread Node pair and working set, L1 sized out to DRAM,
+    // then the largest working set again under load, the per pair bandwidth with the current kernel,
+    // and the remote / local ratios next to the firmware distance table (distance / 10)
+    // The chains live in the first Frames of each Node's pool, the load runs over the Frames after them
+    void run_latency_matrix(const LatencyOptions& latency_options = {}) {
+        const size_t reserve = latency_options.loaded ? 1 : 0;  // Frames left over for the load
+        std::vector<size_t> working_sets;
+        for (size_t bytes : latency_options.working_sets) {
+            bool fits = std::all_of(allocators.begin(), allocators.end(), [&](const auto& allocator) {
+                return LatencyProbe::frames_needed(bytes, allocator->get_frame_size()) + reserve <= allocator->getFrames().size();
+                });
+            if (fits)
+                working_sets.push_back(bytes);
+            else
+                std::cout << "Latency: skipping " << bytes / 1024 << " KB working set, larger than the pools" << std::endl;
+        }
+        if (working_sets.empty())
+            return;
 
-            // Measure the Duration
-            auto end = std::chrono::high_resolution_clock::now();
-            std::chrono::duration<double> duration = end - start;
-            durations.push_back(duration);
-            std::cout << " Duration: " << duration.count() << std::endl;
+        // latency[w][memoryNode][threadNode] in ns per load
+        std::vector<std::vector<std::vector<double>>> latency(working_sets.size(),
+            std::vector<std::vector<double>>(num_nodes, std::vector<double>(num_nodes, 0.0)));
+        std::vector<std::vector<double>> loaded(num_nodes, std::vector<double>(num_nodes, 0.0));
+        std::vector<std::vector<double>> bandwidth(num_nodes, std::vector<double>(num_nodes, 0.0));
 
-            if (withSleep)
-                std::this_thread::sleep_for(std::chrono::seconds(5));
+        for (size_t memoryNode = 0; memoryNode < num_nodes; ++memoryNode) {
+            const auto& frames = allocators[memoryNode]->getFrames();
+            const size_t frame_size = allocators[memoryNode]->get_frame_size();
+            for (size_t w = 0; w < working_sets.size(); ++w) {
+                void* head = LatencyProbe::build_chain(frames, frame_size, working_sets[w], 0x5EED + memoryNode);
+                for (size_t threadNode = 0; threadNode < num_nodes; ++threadNode)
+                    latency[w][memoryNode][threadNode] = chase_on(threadNode, head, latency_options.loads);
+            }
+
+            // The largest chain is still in place, chase it again with the rest of the machine hammering the Node
+            if (latency_options.loaded) {
+                void* head = LatencyProbe::build_chain(frames, frame_size, working_sets.back(), 0x5EED + memoryNode);
+                const size_t first_load_frame = LatencyProbe::frames_needed(working_sets.back(), frame_size);
+                for (size_t threadNode = 0; threadNode < num_nodes; ++threadNode)
+                    loaded[memoryNode][threadNode] = chase_loaded(memoryNode, threadNode, head, first_load_frame, latency_options.loads);
+            }
         }
 
-        // Run Each Memory node against ALL the other Thread nodes
-        // Give WORST case when ALL Cores running 
-        std::cout << "Testing ALL Nodes WORST: ";
-        {
-            // Run Each Memory node against Each Thread node
-            auto start = std::chrono::high_resolution_clock::now();
-            for (size_t memoryNode = 0; memoryNode < num_nodes; ++memoryNode) {
-                for (size_t threadNode = 0; threadNode < num_nodes; ++threadNode) {
-
-                    // Ignore Self, already tested above as BEST case
-                    if (threadNode == memoryNode)
-                        continue;
-                    
-                    // Run Every Frame from memoryNode on threadNode - do it nLoops times
-                    for (size_t nLoop = 0; nLoop < nLoops; ++nLoop) {
-                        for (auto frame : allocators[memoryNode]->getFrames()) {
-                            thread_pools[threadNode]->enqueue([frame]() {
-                                process_frame(frame, FRAME_SIZE);
-                                });
-                        }
-                    }
+        // Bandwidth last, the kernel overwrites the chains
+        for (size_t memoryNode = 0; memoryNode < num_nodes; ++memoryNode) {
+            for (size_t threadNode = 0; threadNode < num_nodes; ++threadNode) {
+                Scenario pair{ "pair", { { memoryNode, threadNode } } };
+                for (size_t attempt = 0; attempt < 2; ++attempt) {
+                    ScenarioTiming timing = run_scenario(pair, 1);
+                    if (timing.seconds > 0.0)
+                        bandwidth[memoryNode][threadNode] = std::max(bandwidth[memoryNode][threadNode], timing.bytes / timing.seconds / 1e9);
                 }
             }
+        }
 
-            // Wait for all threads to finish
-            for (size_t threadNode = 0; threadNode < num_nodes; ++threadNode)
-                thread_pools[threadNode]->wait_for_all();
-
-            // Measure the Duration
-            auto end = std::chrono::high_resolution_clock::now();
-            std::chrono::duration<double> duration = end - start;
-            durations.push_back(duration);
-            std::cout << " Duration: " << duration.count() << std::endl;
+        for (size_t w = 0; w < working_sets.size(); ++w)
+            print_matrix("Latency ns/load, " + std::to_string(working_sets[w] / 1024) + " KB working set", latency[w], 1);
+        if (latency_options.loaded)
+            print_matrix("Loaded latency ns/load, " + std::to_string(working_sets.back() / 1024) + " KB working set, every other pool thread running the kernel", loaded, 1);
+        print_matrix("Bandwidth GB/s, every thread of the Thread Node", bandwidth, 2);
 
-            if (withSleep)
-                std::this_thread::sleep_for(std::chrono::seconds(5));
+        // Remote over local latency against what the firmware claims
+        std::vector<std::vector<double>> measured(num_nodes, std::vector<double>(num_nodes, 0.0));
+        std::vector<std::vector<double>> firmware(num_nodes, std::vector<double>(num_nodes, 0.0));
+        for (size_t memoryNode = 0; memoryNode < num_nodes; ++memoryNode) {
+            for (size_t threadNode = 0; threadNode < num_nodes; ++threadNode) {
+                const double local = latency.back()[threadNode][threadNode];
+                measured[memoryNode][threadNode] = local > 0.0 ? latency.back()[memoryNode][threadNode] / local : 0.0;
+                firmware[memoryNode][threadNode] = topology.distance(memoryNode, threadNode) / static_cast<double>(Topology::LOCAL_DISTANCE);
+            }
         }
+        print_matrix("Measured remote / local latency, " + std::to_string(working_sets.back() / 1024) + " KB working set", measured, 2);
+        print_matrix("Firmware distance / 10", firmware, 2);
     }
 
-    // Print the durations
-    void print_durations() const {
-        for (const auto& duration : durations) {
-            std::cout << "Duration: " << duration.count() << " seconds\n";
-        }
+    // OS thread ids of every Node's ThreadPool, indexed like the Nodes
+    std::vector<std::vector<int64_t>> get_thread_ids() const {
+        std::vector<std::vector<int64_t>> ids;
+        for (const auto& pool : thread_pools)
+            ids.push_back(pool->get_thread_ids());
+        return ids;
+    }
+
+    // Telemetry of every Node's ThreadPool, indexed like the Nodes
+    std::vector<Telemetry::PoolSnapshot> get_telemetry() const {
+        std::vector<Telemetry::PoolSnapshot> snapshots;
+        for (const auto& pool : thread_pools)
+            snapshots.push_back(pool->get_telemetry());
+        return snapshots;
+    }
+
+    FramePool& get_frame_pool() {
+        return *frame_pool;
+    }
+
+    FrameDispatcher& get_dispatcher() {
+        return *dispatcher;
     }
 
 private:
+    // One Frame's trip along the route, the kernel runs on each Node's pool in turn, returns the bytes processed
+    CoTask<uint64_t> frame_job(std::byte* frame, size_t frame_size, std::vector<size_t> route) {
+        uint64_t bytes = 0;
+        for (size_t node : route) {
+            co_await schedule_on(node);
+            kernel(frame, frame_size);
+            bytes += frame_size;
+        }
+        co_return bytes;
+    }
+
+    Topology topology;
     size_t num_nodes;
     std::vector<std::unique_ptr<MemoryAllocator>> allocators;
+    std::unique_ptr<FramePool> frame_pool;
     std::vector<std::unique_ptr<ThreadPool>> thread_pools;
-    std::vector<std::chrono::duration<double>> durations;
+    std::unique_ptr<FrameDispatcher> dispatcher;
+    FrameKernel kernel = FrameKernels::fill_scalar;
+    std::vector<ScenarioSpec> scenario_specs;
+
+    // An interleaved or replicated pool, Memory Node num_nodes + its index
+    struct ExtraPool {
+        PoolPlacement placement = PoolPlacement::Local;
+        std::unique_ptr<MemoryAllocator> interleaved;
+        std::unique_ptr<ReplicatedPool> replicated;
+    };
+    std::vector<ExtraPool> extra_pools;
+
+    // Memory a Thread Node reads for a Memory Node: the Node pool, the interleaved pool,
+    // or the Thread Node's own copy of a replicated pool, the same one ReplicatedPool::local() gives its threads
+    const MemoryAllocator& memory_for(size_t memoryNode, size_t threadNode) const {
+        if (memoryNode < num_nodes)
+            return *allocators[memoryNode];
+        const ExtraPool& extra = extra_pools[memoryNode - num_nodes];
+        return extra.replicated ? extra.replicated->replica(threadNode) : *extra.interleaved;
+    }
+
+    // Chase the chain on one of threadNode's pool threads
+    double chase_on(size_t threadNode, void* head, size_t loads) {
+        double ns = 0.0;
+        thread_pools[threadNode]->enqueue([&ns, head, loads]() { ns = LatencyProbe::chase(head, loads); });
+        thread_pools[threadNode]->wait_for_all();
+        return ns;
+    }
+
+    // Chase on one of threadNode's threads while every other pool thread runs the kernel over memoryNode's Frames
+    // from first_load_frame on, each pool gets exactly one Task per thread so the chase always finds a free thread
+    double chase_loaded(size_t memoryNode, size_t threadNode, void* head, size_t first_load_frame, size_t loads) {
+        std::atomic<bool> stop{ false };
+        const auto& frames = allocators[memoryNode]->getFrames();
+        const size_t frame_size = allocators[memoryNode]->get_frame_size();
+        auto load = [&stop, &frames, first_load_frame, frame_size, frame_kernel = kernel]() {
+            while (!stop.load(std::memory_order_relaxed)) {
+                for (size_t f = first_load_frame; f < frames.size() && !stop.load(std::memory_order_relaxed); ++f)
+                    frame_kernel(frames[f], frame_size);
+            }
+            };
+
+        for (size_t node = 0; node < num_nodes; ++node) {
+            const size_t threads = thread_pools[node]->get_num_threads() - (node == threadNode ? 1 : 0);
+            for (size_t i = 0; i < threads; ++i)
+                thread_pools[node]->enqueue(load);
+        }
+        double ns = 0.0;
+        thread_pools[threadNode]->enqueue([&ns, &stop, head, loads]() {
+            ns = LatencyProbe::chase(head, loads);
+            stop.store(true);
+            });
+        for (auto& pool : thread_pools)
+            pool->wait_for_all();
+        return ns;
+    }
+
+    // Rows are Memory Nodes, columns Thread Nodes
+    void print_matrix(const std::string& title, const std::vector<std::vector<double>>& values, int precision) const {
+        std::cout << title << "\n" << std::setw(10) << "Mem\\Thr";
+        for (size_t threadNode = 0; threadNode < num_nodes; ++threadNode)
+            std::cout << std::setw(9) << topology.get_nodes()[threadNode].id;
+        std::cout << "\n" << std::fixed << std::setprecision(precision);
+        for (size_t memoryNode = 0; memoryNode < num_nodes; ++memoryNode) {
+            std::cout << std::setw(10) << topology.get_nodes()[memoryNode].id;
+            for (size_t threadNode = 0; threadNode < num_nodes; ++threadNode)
+                std::cout << std::setw(9) << values[memoryNode][threadNode];
+            std::cout << "\n";
+        }
+        std::cout << std::endl;
+    }
 
-    // Helper function to Process a frame
-    // This could be easily changed to a more complex function if needed
-    static void process_frame(std::byte* frame, size_t size) {
-        std::fill(frame, frame + size, std::byte{ 0xAA });
+    // Queue the run's slice of the Memory Node's Frames on its Thread Node, nLoops times over, as one bulk range
+    // Each thread claims a Frame at a time, a 6MB Frame is plenty of work per claim
+    // Returns the Frames in the slice
+    size_t submit_frames(const ScenarioRun& run, size_t nLoops) {
+        const MemoryAllocator& memory = memory_for(run.memory_node, run.thread_node);
+        const auto& frames = memory.getFrames();
+        const size_t stride = std::max<size_t>(1, run.stride);
+        size_t slice = frames.size() > run.first ? (frames.size() - run.first + stride - 1) / stride : 0;
+        if (run.count)
+            slice = std::min(slice, run.count);
+        if (slice == 0)
+            return 0;
+        thread_pools[run.thread_node]->parallel_for(0, nLoops * slice, 1,
+            [&frames, first = run.first, stride, slice, frame_size = memory.get_frame_size(), frame_kernel = kernel](size_t index) {
+            frame_kernel(frames[first + (index % slice) * stride], frame_size);
+            });
+        return slice;
     }
 };
 
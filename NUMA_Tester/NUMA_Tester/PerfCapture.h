@@ -0,0 +1,121 @@
+#ifndef PERF_CAPTURE_H
+#define PERF_CAPTURE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "PerfCounter.h"
+#include "Platform.h"
+
+// One value per scenario_events() entry, -1 where the event could not be counted
+using PerfValues = std::array<int64_t, PERF_EVENT_COUNT>;
+
+inline PerfValues no_perf_values() {
+    PerfValues values;
+    values.fill(-1);
+    return values;
+}
+
+// Counts of one pool thread
+struct ThreadCounters {
+    size_t node = 0;        // Topology Node index of the pool
+    size_t thread = 0;      // Thread index within the pool
+    int64_t tid = 0;
+    PerfValues values = no_perf_values();
+};
+
+// The scenario_events() counted on every ThreadPool thread of every Node, run with --perf
+// The counters are opened once, start/stop bracket each Scenario
+// Each event is opened on its own rather than as a perf group, so a PMU with too few counters
+// multiplexes them (and read() scales) instead of refusing the whole set
+// Events the kernel or the PMU refuses are left out, on a VM or in a container that can be all of them
+class PerfCapture {
+public:
+    // thread_ids[node] are the OS thread ids of that Node's pool, see NodeManager::get_thread_ids
+    explicit PerfCapture(const std::vector<std::vector<int64_t>>& thread_ids) {
+        Platform::raise_open_file_limit();
+        for (size_t node = 0; node < thread_ids.size(); ++node) {
+            for (size_t thread = 0; thread < thread_ids[node].size(); ++thread) {
+                Thread entry;
+                entry.node = node;
+                entry.thread = thread;
+                entry.tid = thread_ids[node][thread];
+                for (size_t event = 0; event < PERF_EVENT_COUNT; ++event) {
+                    const PerfEvent& info = scenario_events()[event];
+                    entry.counters[event] = std::make_unique<PerfCounter>(info.type, info.config, static_cast<int>(entry.tid));
+                    event_available[event] = event_available[event] || entry.counters[event]->valid();
+                }
+                threads.push_back(std::move(entry));
+            }
+        }
+    }
+
+    // True if at least one event could be opened on at least one thread
+    bool available() const {
+        for (bool event : event_available) {
+            if (event)
+                return true;
+        }
+        return false;
+    }
+
+    bool available(size_t event) const {
+        return event_available[event];
+    }
+
+    void start() {
+        for (auto& thread : threads) {
+            for (auto& counter : thread.counters)
+                counter->start();
+        }
+    }
+
+    void stop() {
+        for (auto& thread : threads) {
+            for (auto& counter : thread.counters)
+                counter->stop();
+        }
+    }
+
+    // Counts since start() for every thread
+    std::vector<ThreadCounters> read() const {
+        std::vector<ThreadCounters> result;
+        for (const auto& thread : threads) {
+            ThreadCounters counts;
+            counts.node = thread.node;
+            counts.thread = thread.thread;
+            counts.tid = thread.tid;
+            for (size_t event = 0; event < PERF_EVENT_COUNT; ++event)
+                counts.values[event] = thread.counters[event]->valid() ? static_cast<int64_t>(thread.counters[event]->read()) : -1;
+            result.push_back(counts);
+        }
+        return result;
+    }
+
+    // Sum over threads, an event stays -1 only if no thread could count it
+    static PerfValues total(const std::vector<ThreadCounters>& counts) {
+        PerfValues sum = no_perf_values();
+        for (const auto& thread : counts) {
+            for (size_t event = 0; event < PERF_EVENT_COUNT; ++event) {
+                if (thread.values[event] >= 0)
+                    sum[event] = (sum[event] < 0 ? 0 : sum[event]) + thread.values[event];
+            }
+        }
+        return sum;
+    }
+
+private:
+    struct Thread {
+        size_t node = 0;
+        size_t thread = 0;
+        int64_t tid = 0;
+        std::array<std::unique_ptr<PerfCounter>, PERF_EVENT_COUNT> counters;
+    };
+
+    std::vector<Thread> threads;
+    std::array<bool, PERF_EVENT_COUNT> event_available{};
+};
+
+#endif // PERF_CAPTURE_H
@@ -0,0 +1,135 @@
+#ifndef PERF_COUNTER_H
+#define PERF_COUNTER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#ifndef _WIN32
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#ifndef _WIN32
+// Generic hardware cache event config: cache | (op << 8) | (result << 16)
+constexpr uint64_t perf_cache_event(uint64_t cache, uint64_t op, uint64_t result) {
+    return cache | (op << 8) | (result << 16);
+}
+#endif
+
+// One hardware event counted for one thread (the caller by default) with perf_event_open
+// Not available on Windows or where the kernel says no (VMs, containers, perf_event_paranoid),
+// valid() is then false and read() returns 0, so callers can print "n/a" and carry on
+class PerfCounter {
+public:
+#ifndef _WIN32
+    static constexpr uint32_t TYPE_HARDWARE = PERF_TYPE_HARDWARE;
+    static constexpr uint32_t TYPE_HW_CACHE = PERF_TYPE_HW_CACHE;
+    static constexpr uint64_t DTLB_LOAD_MISSES = perf_cache_event(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS);
+    static constexpr uint64_t DTLB_STORE_MISSES = perf_cache_event(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_WRITE, PERF_COUNT_HW_CACHE_RESULT_MISS);
+    static constexpr uint64_t CYCLES = PERF_COUNT_HW_CPU_CYCLES;
+    static constexpr uint64_t INSTRUCTIONS = PERF_COUNT_HW_INSTRUCTIONS;
+    static constexpr uint64_t LLC_MISSES = PERF_COUNT_HW_CACHE_MISSES;
+    // Loads the "node" cache served: from the local Node's DRAM (access) and from a remote Node (miss)
+    // Only PMUs with the offcore events (Intel server parts mostly) expose these
+    static constexpr uint64_t NODE_LOADS = perf_cache_event(PERF_COUNT_HW_CACHE_NODE, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_ACCESS);
+    static constexpr uint64_t NODE_LOAD_MISSES = perf_cache_event(PERF_COUNT_HW_CACHE_NODE, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS);
+
+    // type/config as in perf_event_attr, tid 0 is the calling thread, any other tid is a thread of this process
+    PerfCounter(uint32_t type, uint64_t config, int tid = 0) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, tid, -1, -1, 0));
+    }
+
+    ~PerfCounter() {
+        if (fd >= 0)
+            close(fd);
+    }
+
+    bool valid() const {
+        return fd >= 0;
+    }
+
+    void start() {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    void stop() {
+        if (fd >= 0)
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+
+    // Count since start(), scaled up by enabled / running time when the kernel had to multiplex the PMU
+    uint64_t read() const {
+        uint64_t values[3] = { 0, 0, 0 };   // value, time enabled, time running
+        if (fd < 0 || ::read(fd, values, sizeof(values)) != sizeof(values) || values[2] == 0)
+            return 0;
+        if (values[2] >= values[1])
+            return values[0];
+        return static_cast<uint64_t>(static_cast<double>(values[0]) * values[1] / values[2]);
+    }
+
+private:
+    int fd = -1;
+#else
+    static constexpr uint32_t TYPE_HARDWARE = 0;
+    static constexpr uint32_t TYPE_HW_CACHE = 0;
+    static constexpr uint64_t DTLB_LOAD_MISSES = 0;
+    static constexpr uint64_t DTLB_STORE_MISSES = 0;
+    static constexpr uint64_t CYCLES = 0;
+    static constexpr uint64_t INSTRUCTIONS = 0;
+    static constexpr uint64_t LLC_MISSES = 0;
+    static constexpr uint64_t NODE_LOADS = 0;
+    static constexpr uint64_t NODE_LOAD_MISSES = 0;
+
+    PerfCounter(uint32_t, uint64_t, int = 0) {
+    }
+
+    bool valid() const { return false; }
+    void start() {}
+    void stop() {}
+    uint64_t read() const { return 0; }
+#endif
+
+public:
+    PerfCounter(const PerfCounter&) = delete;
+    PerfCounter& operator=(const PerfCounter&) = delete;
+};
+
+// The events captured for each Scenario, in report order
+struct PerfEvent {
+    const char* name;
+    uint32_t type;
+    uint64_t config;
+};
+
+constexpr size_t PERF_EVENT_COUNT = 7;
+
+inline const std::array<PerfEvent, PERF_EVENT_COUNT>& scenario_events() {
+    static const std::array<PerfEvent, PERF_EVENT_COUNT> events = { {
+        { "cycles", PerfCounter::TYPE_HARDWARE, PerfCounter::CYCLES },
+        { "instructions", PerfCounter::TYPE_HARDWARE, PerfCounter::INSTRUCTIONS },
+        { "llc_misses", PerfCounter::TYPE_HARDWARE, PerfCounter::LLC_MISSES },
+        { "local_dram", PerfCounter::TYPE_HW_CACHE, PerfCounter::NODE_LOADS },
+        { "remote_dram", PerfCounter::TYPE_HW_CACHE, PerfCounter::NODE_LOAD_MISSES },
+        { "dtlb_load_misses", PerfCounter::TYPE_HW_CACHE, PerfCounter::DTLB_LOAD_MISSES },
+        { "dtlb_store_misses", PerfCounter::TYPE_HW_CACHE, PerfCounter::DTLB_STORE_MISSES },
+    } };
+    return events;
+}
+
+#endif // PERF_COUNTER_H
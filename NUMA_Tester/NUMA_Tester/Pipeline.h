@@ -0,0 +1,212 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "FrameKernels.h"
+#include "FramePool.h"
+#include "Platform.h"
+#include "SpscRing.h"
+#include "Topology.h"
+
+// One step of the pipeline, run by one worker per lane pinned to the Node
+struct PipelineStage {
+    std::string name;
+    size_t node = 0;        // Topology index
+    FrameKernel kernel = nullptr;
+};
+
+struct PipelineOptions {
+    size_t lanes = 2;               // Workers per stage, each lane is its own chain of rings
+    size_t ring_capacity = 8;       // Frames a ring holds before the stage feeding it has to wait
+    size_t frames = 256;            // Frames pushed through the pipeline in total
+    size_t frame_size = FRAME_SIZE; // Bytes every kernel runs over
+};
+
+// What one stage did, summed over its lanes, times in seconds
+struct StageStats {
+    std::string name;
+    size_t node = 0;
+    uint64_t frames = 0;
+    double busy = 0.0;          // In the kernel
+    double starved = 0.0;       // Waiting for a Frame from the stage before, the first stage for one to come back
+    double blocked = 0.0;       // Waiting for room in the ring to the stage after, the backpressure
+    double mean_depth = 0.0;    // Frames waiting in the input ring when the stage took one
+    size_t max_depth = 0;
+};
+
+struct PipelineResult {
+    double seconds = 0.0;
+    uint64_t frames = 0;
+    uint64_t bytes = 0;         // Frame bytes, counted once per Frame
+    size_t frames_in_flight = 0;
+    std::vector<StageStats> stages;
+};
+
+// Stages on chosen Nodes, one worker thread per stage and lane, joined by bounded SPSC rings that pass Frame pointers
+// Every lane owns a fixed set of Frames leased from the first stage's Node; the last stage hands each one back
+// to the first through a return ring, so nothing is copied or allocated while the pipeline runs
+// and a slow stage fills the rings in front of it until the first stage waits for Frames: backpressure end to end
+class Pipeline {
+public:
+    Pipeline(const Topology& topology, FramePool& frame_pool, const std::vector<PipelineStage>& stages, const PipelineOptions& options = {})
+        : topology(topology), frame_pool(frame_pool), stages(stages), options(options) {
+    }
+
+    // Push options.frames through and wait for the last, an empty result if there were no stages or no Frames to lease
+    PipelineResult run() {
+        PipelineResult result;
+        const size_t num_stages = stages.size();
+        const size_t lanes = std::max<size_t>(1, std::min(options.lanes, options.frames));
+        if (num_stages == 0)
+            return result;
+
+        // Enough Frames per lane to fill every ring and have one in every stage
+        std::vector<std::vector<FrameLease>> leases(lanes);
+        const size_t wanted = options.ring_capacity * (num_stages - 1) + num_stages;
+        for (size_t i = 0; i < wanted; ++i) {
+            for (size_t lane = 0; lane < lanes; ++lane) {
+                FrameLease lease = frame_pool.acquire(stages.front().node);
+                if (lease)
+                    leases[lane].push_back(std::move(lease));
+            }
+        }
+        for (const auto& lane : leases) {
+            if (lane.empty())
+                return result;
+            result.frames_in_flight += lane.size();
+        }
+
+        // rings[lane][s] feeds stage s + 1, rings[lane][num_stages - 1] takes Frames back to stage 0
+        std::vector<std::vector<std::unique_ptr<SpscRing<std::byte*>>>> rings(lanes);
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            for (size_t s = 0; s < num_stages; ++s)
+                rings[lane].push_back(std::make_unique<SpscRing<std::byte*>>(s + 1 < num_stages ? options.ring_capacity : leases[lane].size()));
+            for (const FrameLease& lease : leases[lane])
+                rings[lane].back()->try_push(lease.data());
+        }
+
+        std::vector<std::vector<Counters>> counters(lanes, std::vector<Counters>(num_stages));
+        std::atomic<size_t> ready{ 0 };
+        std::atomic<bool> go{ false };
+        std::vector<std::thread> workers;
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            const size_t lane_frames = options.frames / lanes + (lane < options.frames % lanes ? 1 : 0);
+            for (size_t s = 0; s < num_stages; ++s) {
+                SpscRing<std::byte*>& input = *rings[lane][(s + num_stages - 1) % num_stages];
+                SpscRing<std::byte*>& output = *rings[lane][s];
+                workers.emplace_back([this, &input, &output, &counters, &ready, &go, lane, s, lane_frames]() {
+                    // A refused pin (fake topology, container) only costs locality, the ThreadPools already warn about it
+                    Platform::pin_current_thread(topology.get_nodes()[stages[s].node].cpus);
+                    ready.fetch_add(1);
+                    while (!go.load(std::memory_order_acquire))
+                        std::this_thread::yield();
+                    work(stages[s].kernel, input, output, counters[lane][s], lane_frames);
+                    });
+            }
+        }
+        while (ready.load() < workers.size())
+            std::this_thread::yield();
+        auto start = std::chrono::high_resolution_clock::now();
+        go.store(true, std::memory_order_release);
+        for (auto& worker : workers)
+            worker.join();
+        std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - start;
+
+        result.seconds = duration.count();
+        result.frames = options.frames;
+        result.bytes = options.frames * options.frame_size;
+        for (size_t s = 0; s < num_stages; ++s) {
+            StageStats stats;
+            stats.name = stages[s].name;
+            stats.node = stages[s].node;
+            uint64_t depth_sum = 0;
+            for (size_t lane = 0; lane < lanes; ++lane) {
+                const Counters& c = counters[lane][s];
+                stats.frames += c.frames;
+                stats.busy += c.busy_ns / 1e9;
+                stats.starved += c.starved_ns / 1e9;
+                stats.blocked += c.blocked_ns / 1e9;
+                stats.max_depth = std::max(stats.max_depth, c.max_depth);
+                depth_sum += c.depth_sum;
+            }
+            stats.mean_depth = stats.frames ? static_cast<double>(depth_sum) / stats.frames : 0.0;
+            result.stages.push_back(stats);
+        }
+        return result;
+    }
+
+    // Throughput, then one line per stage
+    static void print(const PipelineResult& result, std::ostream& os) {
+        os << std::fixed << std::setprecision(4) << "Pipeline: " << result.frames << " Frames in " << result.seconds << " s, "
+            << std::setprecision(1) << (result.seconds > 0.0 ? result.frames / result.seconds : 0.0) << " fps, "
+            << std::setprecision(2) << (result.seconds > 0.0 ? result.bytes / result.seconds / 1e9 : 0.0) << " GB/s, "
+            << result.frames_in_flight << " Frames in flight\n";
+        os << std::setw(12) << "Stage" << std::setw(6) << "Node" << std::setw(10) << "Frames" << std::setw(10) << "fps"
+            << std::setw(10) << "Busy s" << std::setw(10) << "Starved s" << std::setw(10) << "Blocked s"
+            << std::setw(11) << "Mean depth" << std::setw(10) << "Max depth" << "\n";
+        for (const StageStats& stage : result.stages) {
+            os << std::setw(12) << stage.name << std::setw(6) << stage.node << std::setw(10) << stage.frames
+                << std::setprecision(1) << std::setw(10) << (stage.busy > 0.0 ? stage.frames / stage.busy : 0.0)
+                << std::setprecision(4) << std::setw(10) << stage.busy << std::setw(10) << stage.starved << std::setw(10) << stage.blocked
+                << std::setprecision(2) << std::setw(11) << stage.mean_depth << std::setw(10) << stage.max_depth << "\n";
+        }
+        os << std::flush;
+    }
+
+private:
+    // One worker's numbers, only that worker writes them and they are read after it is joined
+    struct alignas(CACHE_LINE_SIZE) Counters {
+        uint64_t frames = 0;
+        uint64_t busy_ns = 0;
+        uint64_t starved_ns = 0;
+        uint64_t blocked_ns = 0;
+        uint64_t depth_sum = 0;
+        size_t max_depth = 0;
+    };
+
+    const Topology& topology;
+    FramePool& frame_pool;
+    std::vector<PipelineStage> stages;
+    PipelineOptions options;
+
+    static uint64_t now_ns() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // Take a Frame, run the kernel, pass it on, frames times; stage 0's input is the lane's free Frames
+    void work(FrameKernel kernel, SpscRing<std::byte*>& input, SpscRing<std::byte*>& output, Counters& counters, size_t frames) {
+        for (size_t i = 0; i < frames; ++i) {
+            std::byte* frame = nullptr;
+            uint64_t start = now_ns();
+            while (!input.try_pop(frame))
+                std::this_thread::yield();
+            const size_t depth = input.size() + 1;
+            counters.depth_sum += depth;
+            counters.max_depth = std::max(counters.max_depth, depth);
+
+            uint64_t ran = now_ns();
+            counters.starved_ns += ran - start;
+            kernel(frame, options.frame_size);
+            uint64_t done = now_ns();
+            counters.busy_ns += done - ran;
+
+            while (!output.try_push(frame))
+                std::this_thread::yield();
+            counters.blocked_ns += now_ns() - done;
+            ++counters.frames;
+        }
+    }
+};
+
+#endif // PIPELINE_H
@@ -0,0 +1,395 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+#include "CpuSet.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <conio.h>
+#include <psapi.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+#endif
+
+// Thin OS layer for the NUMA pieces: node bound allocations, thread pinning and console helpers
+// Everything above this header is platform independent
+namespace Platform {
+
+    // Size of the pages the OS hands out by default
+    inline size_t page_size() {
+#ifdef _WIN32
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        return info.dwPageSize;
+#else
+        return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+    }
+
+    // Pin the calling thread to the CPUs in the set
+    // On Windows a thread lives in one processor group, so the first group with CPUs in the set is used
+    inline bool pin_current_thread(const CpuSet& cpus) {
+#ifdef _WIN32
+        for (size_t group = 0; group * 64 < cpus.capacity(); ++group) {
+            uint64_t mask = cpus.word(group);
+            if (!mask)
+                continue;
+            GROUP_AFFINITY affinity = {};
+            affinity.Group = static_cast<WORD>(group);
+            affinity.Mask = static_cast<KAFFINITY>(mask);
+            return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+        }
+        return false;
+#else
+        size_t num_cpus = std::max<size_t>(cpus.capacity(), CPU_SETSIZE);
+        cpu_set_t* set = CPU_ALLOC(num_cpus);
+        size_t set_size = CPU_ALLOC_SIZE(num_cpus);
+        CPU_ZERO_S(set_size, set);
+        for (size_t cpu : cpus.cpus())
+            CPU_SET_S(cpu, set_size, set);
+        bool pinned = pthread_setaffinity_np(pthread_self(), set_size, set) == 0;
+        CPU_FREE(set);
+        return pinned;
+#endif
+    }
+
+    // The logical CPU the calling thread is running on right now
+    inline size_t current_cpu() {
+#ifdef _WIN32
+        PROCESSOR_NUMBER number;
+        GetCurrentProcessorNumberEx(&number);
+        return static_cast<size_t>(number.Group) * 64 + number.Number;
+#else
+        int cpu = sched_getcpu();
+        return cpu < 0 ? 0 : static_cast<size_t>(cpu);
+#endif
+    }
+
+    // How the pages behind a Node pool are backed
+    enum class PageBackend {
+        Default,        // Base pages (4KB)
+        Transparent,    // Base pages with transparent huge pages requested (Linux THP)
+        Huge2MB,        // Explicit 2MB pages (hugetlbfs / Windows large pages)
+        Huge1GB         // Explicit 1GB pages (hugetlbfs, Windows falls back to large pages)
+    };
+
+    inline const char* page_backend_name(PageBackend backend) {
+        switch (backend) {
+        case PageBackend::Transparent: return "thp";
+        case PageBackend::Huge2MB: return "2m";
+        case PageBackend::Huge1GB: return "1g";
+        default: return "default";
+        }
+    }
+
+    // Memory handed out by allocate_on_node: the mapping may be bigger than asked for (rounded to the page size)
+    // and the backend may be a fallback from the one requested
+    struct NodeMemory {
+        std::byte* ptr = nullptr;
+        size_t bytes = 0;
+        PageBackend backend = PageBackend::Default;
+        size_t page = 0;
+    };
+
+    inline size_t round_up(size_t value, size_t multiple) {
+        return (value + multiple - 1) / multiple * multiple;
+    }
+
+#ifdef _WIN32
+    // Large pages need SeLockMemoryPrivilege in the process token, ask for it once
+    inline bool enable_large_pages() {
+        static const bool enabled = []() {
+            HANDLE token;
+            if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+                return false;
+            TOKEN_PRIVILEGES privileges = {};
+            privileges.PrivilegeCount = 1;
+            privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+            bool ok = LookupPrivilegeValue(nullptr, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid)
+                && AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr)
+                && GetLastError() == ERROR_SUCCESS;
+            CloseHandle(token);
+            return ok;
+        }();
+        return enabled;
+    }
+#endif
+
+    // Reserve and commit bytes with the physical pages bound to the given NUMA node
+    // The binding is explicit, so it does not matter which thread first touches the pages
+    // Huge page backends that can not be had (no pages reserved, no privilege) fall back one step at a time:
+    // 1GB -> 2MB -> transparent -> default, with a warning, so the caller always gets memory
+    // If the OS refuses the binding (no NUMA support, container policy) the memory is still returned and a warning printed
+    // More than one node interleaves the pages round robin over them (MPOL_INTERLEAVE), the first node names the memory
+    // in messages; Windows has no interleave policy, so there each 64KB slice is committed preferring the next node
+    inline NodeMemory allocate_on_nodes(size_t bytes, const std::vector<size_t>& nodes, PageBackend backend = PageBackend::Default) {
+        NodeMemory memory;
+        const size_t node = nodes.front();
+#ifdef _WIN32
+        if (nodes.size() > 1) {
+            if (backend != PageBackend::Default)
+                std::cerr << "Interleaved pools use default pages on Windows" << std::endl;
+            const size_t slice = 64 * 1024;
+            memory.bytes = round_up(bytes, slice);
+            memory.page = page_size();
+            memory.ptr = static_cast<std::byte*>(VirtualAlloc(nullptr, memory.bytes, MEM_RESERVE, PAGE_READWRITE));
+            if (!memory.ptr)
+                throw std::bad_alloc();
+            for (size_t offset = 0, i = 0; offset < memory.bytes; offset += slice, ++i) {
+                if (!VirtualAllocExNuma(GetCurrentProcess(), memory.ptr + offset, slice, MEM_COMMIT, PAGE_READWRITE,
+                    static_cast<DWORD>(nodes[i % nodes.size()]))) {
+                    VirtualFree(memory.ptr, 0, MEM_RELEASE);
+                    throw std::bad_alloc();
+                }
+            }
+            return memory;
+        }
+        if (backend == PageBackend::Huge1GB || backend == PageBackend::Huge2MB) {
+            const size_t large_page = GetLargePageMinimum();
+            if (large_page && enable_large_pages()) {
+                memory.bytes = round_up(bytes, large_page);
+                memory.ptr = static_cast<std::byte*>(VirtualAllocExNuma(GetCurrentProcess(), nullptr, memory.bytes,
+                    MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE, static_cast<DWORD>(node)));
+                if (memory.ptr) {
+                    memory.backend = PageBackend::Huge2MB;
+                    memory.page = large_page;
+                    return memory;
+                }
+            }
+            std::cerr << "Large pages unavailable for node " << node << " (needs the Lock pages in memory right), using default pages" << std::endl;
+        }
+        else if (backend == PageBackend::Transparent) {
+            std::cerr << "Transparent huge pages are Linux only, using default pages" << std::endl;
+        }
+
+        memory.bytes = bytes;
+        memory.page = page_size();
+        memory.ptr = static_cast<std::byte*>(VirtualAllocExNuma(GetCurrentProcess(), nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, static_cast<DWORD>(node)));
+        if (!memory.ptr) {
+            std::cerr << "VirtualAllocExNuma failed for node " << node << ", falling back to VirtualAlloc" << std::endl;
+            memory.ptr = static_cast<std::byte*>(VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+        }
+        if (!memory.ptr)
+            throw std::bad_alloc();
+        return memory;
+#else
+        auto map = [&](int flags, size_t page) {
+            memory.bytes = round_up(bytes, page);
+            memory.page = page;
+            void* ptr = mmap(nullptr, memory.bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+            memory.ptr = (ptr == MAP_FAILED) ? nullptr : static_cast<std::byte*>(ptr);
+            return memory.ptr != nullptr;
+        };
+
+        memory.backend = backend;
+        if (backend == PageBackend::Huge1GB && !map(MAP_HUGETLB | MAP_HUGE_1GB, 1ULL << 30)) {
+            std::cerr << "No 1GB huge pages for node " << node << " (see /sys/kernel/mm/hugepages), trying 2MB" << std::endl;
+            memory.backend = PageBackend::Huge2MB;
+        }
+        if (memory.backend == PageBackend::Huge2MB && !memory.ptr && !map(MAP_HUGETLB | MAP_HUGE_2MB, 2ULL << 20)) {
+            std::cerr << "No 2MB huge pages for node " << node << " (see vm.nr_hugepages), trying transparent huge pages" << std::endl;
+            memory.backend = PageBackend::Transparent;
+        }
+        if (memory.backend == PageBackend::Transparent && !memory.ptr) {
+            // THP only backs 2MB aligned ranges, so over map and trim to a 2MB boundary
+            const size_t huge = 2ULL << 20;
+            const size_t wanted = round_up(bytes, huge);
+            void* raw = mmap(nullptr, wanted + huge, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (raw == MAP_FAILED)
+                throw std::bad_alloc();
+            std::byte* aligned = reinterpret_cast<std::byte*>(round_up(reinterpret_cast<uintptr_t>(raw), huge));
+            if (aligned != raw)
+                munmap(raw, aligned - static_cast<std::byte*>(raw));
+            munmap(aligned + wanted, static_cast<std::byte*>(raw) + wanted + huge - (aligned + wanted));
+            memory.ptr = aligned;
+            memory.bytes = wanted;
+            memory.page = huge;
+            if (madvise(memory.ptr, memory.bytes, MADV_HUGEPAGE) != 0) {
+                std::perror("madvise(MADV_HUGEPAGE)");
+                std::cerr << "Transparent huge pages refused for node " << node << ", using default pages" << std::endl;
+                memory.backend = PageBackend::Default;
+                memory.page = page_size();
+            }
+        }
+        if (!memory.ptr) {
+            memory.backend = PageBackend::Default;
+            if (!map(0, page_size()))
+                throw std::bad_alloc();
+        }
+
+        // Node mask with the nodes set, the kernel reads (maxnode - 1) bits
+        const size_t bits = 8 * sizeof(unsigned long);
+        std::vector<unsigned long> nodemask(*std::max_element(nodes.begin(), nodes.end()) / bits + 1, 0);
+        for (size_t mask_node : nodes)
+            nodemask[mask_node / bits] |= 1UL << (mask_node % bits);
+        unsigned long maxnode = static_cast<unsigned long>(nodemask.size() * bits + 1);
+        if (syscall(SYS_mbind, memory.ptr, memory.bytes, nodes.size() > 1 ? MPOL_INTERLEAVE : MPOL_BIND, nodemask.data(), maxnode, 0) != 0) {
+            std::perror("mbind");
+            std::cerr << "Could not bind pool to node " << node << (nodes.size() > 1 ? " and the rest of its interleave set" : "")
+                << ", pages will be placed by first touch" << std::endl;
+        }
+        return memory;
+#endif
+    }
+
+    inline NodeMemory allocate_on_node(size_t bytes, size_t node, PageBackend backend = PageBackend::Default) {
+        return allocate_on_nodes(bytes, { node }, backend);
+    }
+
+    // Release memory from allocate_on_node
+    inline void free_on_node(const NodeMemory& memory) {
+        if (!memory.ptr)
+            return;
+#ifdef _WIN32
+        VirtualFree(memory.ptr, 0, MEM_RELEASE);
+#else
+        munmap(memory.ptr, memory.bytes);
+#endif
+    }
+
+    // OS NUMA node the page holding ptr is on right now, -1 if it is not resident or the OS will not say
+    // Linux asks move_pages with no target nodes, which only reports; Windows asks QueryWorkingSetEx
+    inline int page_node(const void* ptr) {
+#ifdef _WIN32
+        PSAPI_WORKING_SET_EX_INFORMATION info = {};
+        info.VirtualAddress = const_cast<void*>(ptr);
+        if (!QueryWorkingSetEx(GetCurrentProcess(), &info, sizeof(info)) || !info.VirtualAttributes.Valid)
+            return -1;
+        return static_cast<int>(info.VirtualAttributes.Node);
+#else
+        void* page = reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(ptr) & ~(page_size() - 1));
+        int status = -1;
+        if (syscall(SYS_move_pages, 0, 1UL, &page, nullptr, &status, 0) != 0)
+            return -1;
+        return status;     // Node, or a negative errno such as -ENOENT for a page not yet faulted in
+#endif
+    }
+
+    // Move the resident pages of [ptr, ptr + bytes) to the OS NUMA node, keeping their addresses
+    // page is the size the range is backed by (NodeMemory::page), 0 for the default page; stepping by a huge page
+    // asks for each huge page once, so the count is in pages of that size
+    // Returns the pages now on the node, -1 if the OS can not move pages (Windows, or the call was refused)
+    // Windows has no in place move for committed memory, callers copy to memory from the target Node instead
+    inline long move_to_node(void* ptr, size_t bytes, size_t node, size_t page = 0) {
+#ifdef _WIN32
+        (void)ptr;
+        (void)bytes;
+        (void)node;
+        (void)page;
+        return -1;
+#else
+        if (page == 0)
+            page = page_size();
+        const uintptr_t first = reinterpret_cast<uintptr_t>(ptr) & ~(page - 1);
+        const uintptr_t last = reinterpret_cast<uintptr_t>(ptr) + bytes;
+        std::vector<void*> pages;
+        for (uintptr_t address = first; address < last; address += page)
+            pages.push_back(reinterpret_cast<void*>(address));
+        std::vector<int> nodes(pages.size(), static_cast<int>(node));
+        std::vector<int> status(pages.size(), -1);
+        if (syscall(SYS_move_pages, 0, pages.size(), pages.data(), nodes.data(), status.data(), MPOL_MF_MOVE) < 0)
+            return -1;
+        return static_cast<long>(std::count(status.begin(), status.end(), static_cast<int>(node)));
+#endif
+    }
+
+    // Touch one byte per page so the whole range is resident before any timing starts
+    inline void prefault(void* ptr, size_t bytes, size_t page) {
+        volatile std::byte* bytes_ptr = static_cast<std::byte*>(ptr);
+        for (size_t offset = 0; offset < bytes; offset += page) {
+            bytes_ptr[offset] = std::byte{ 0 };
+        }
+    }
+
+    // Make a range resident without touching its contents, safe while other threads are writing it
+    // MADV_POPULATE_WRITE (Linux 5.14) faults the pages in for writing; without it, or on Windows, each page
+    // gets an atomic add of 0, which write faults the page but can not overwrite a concurrent store
+    inline void populate(void* ptr, size_t bytes, size_t page) {
+#ifndef _WIN32
+        const uintptr_t first = reinterpret_cast<uintptr_t>(ptr) & ~(page_size() - 1);
+        if (madvise(reinterpret_cast<void*>(first), reinterpret_cast<uintptr_t>(ptr) + bytes - first, MADV_POPULATE_WRITE) == 0)
+            return;
+#endif
+        unsigned char* bytes_ptr = static_cast<unsigned char*>(ptr);
+        for (size_t offset = 0; offset < bytes; offset += page)
+            std::atomic_ref<unsigned char>(bytes_ptr[offset]).fetch_add(0, std::memory_order_relaxed);
+    }
+
+    // OS id of the calling thread, what perf_event_open and the profilers call it
+    inline int64_t current_thread_id() {
+#ifdef _WIN32
+        return static_cast<int64_t>(GetCurrentThreadId());
+#else
+        return static_cast<int64_t>(syscall(SYS_gettid));
+#endif
+    }
+
+    // Lift the open file soft limit to the hard limit, per thread counters need a descriptor each
+    inline void raise_open_file_limit() {
+#ifndef _WIN32
+        rlimit limit;
+        if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+            limit.rlim_cur = limit.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &limit);
+        }
+#endif
+    }
+
+    // Name of this machine, for tagging results
+    inline std::string host_name() {
+#ifdef _WIN32
+        char name[MAX_COMPUTERNAME_LENGTH + 1];
+        DWORD size = sizeof(name);
+        if (GetComputerNameA(name, &size))
+            return std::string(name, size);
+#else
+        char name[256];
+        if (gethostname(name, sizeof(name)) == 0) {
+            name[sizeof(name) - 1] = '\0';
+            return name;
+        }
+#endif
+        return "unknown";
+    }
+
+    // Block until a key is pressed
+    inline void wait_for_key() {
+#ifdef _WIN32
+        _getch();
+#else
+        std::getchar();
+#endif
+    }
+}
+
+#endif // PLATFORM_H
@@ -0,0 +1,181 @@
+#ifndef POOL_BENCHMARK_H
+#define POOL_BENCHMARK_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include "AllocationCounter.h"
+#include "ThreadPool.h"
+#include "Topology.h"
+
+// Small task throughput of the SharedQueue and WorkStealing modes, run with --pool-bench
+// Measures the pool itself, so the tasks only do a few hundred nanoseconds of work
+// --task-bench runs the allocation check and the submit latency numbers for the Task queues
+class PoolBenchmark {
+public:
+    PoolBenchmark(const Topology& topology, size_t node_index = 0)
+        : topology(topology), node_index(node_index) {
+    }
+
+    void run(const std::vector<size_t>& thread_counts = { 1, 2, 4, 8, 16, 24, 32, 48, 64, 96 }) {
+        std::cout << "ThreadPool throughput (million tasks/s) on Node " << topology.get_nodes()[node_index].id << "\n";
+        std::cout << std::setw(8) << "Threads"
+            << std::setw(16) << "Shared flat" << std::setw(16) << "Stealing flat"
+            << std::setw(16) << "Shared nested" << std::setw(16) << "Stealing nested" << "\n";
+
+        for (size_t threads : thread_counts) {
+            std::cout << std::setw(8) << threads << std::fixed << std::setprecision(2)
+                << std::setw(16) << flat(PoolMode::SharedQueue, threads)
+                << std::setw(16) << flat(PoolMode::WorkStealing, threads)
+                << std::setw(16) << nested(PoolMode::SharedQueue, threads)
+                << std::setw(16) << nested(PoolMode::WorkStealing, threads) << std::endl;
+        }
+    }
+
+    // Steady state enqueue/dequeue must not allocate, returns false (and says so) if it did
+    bool run_allocation_check() {
+        bool passed = true;
+        for (PoolMode mode : { PoolMode::SharedQueue, PoolMode::WorkStealing }) {
+            // Room for the whole round, how deep the warmup round gets depends on how fast the threads drain it
+            ThreadPoolOptions check_options = options(mode, 4);
+            check_options.queue_capacity = FLAT_TASKS / 10;
+            ThreadPool pool(topology, node_index, check_options);
+            std::atomic<uint64_t> sink{ 0 };
+            std::array<uint64_t, 4> payload = { 1, 2, 3, 4 };   // A capture bigger than std::function's small buffer
+            auto submit = [&]() {
+                for (size_t i = 0; i < FLAT_TASKS / 10; ++i)
+                    pool.enqueue([&sink, payload]() { sink.fetch_add(payload[0], std::memory_order_relaxed); });
+                pool.wait_for_all();
+            };
+
+            // The first round sizes the rings, the second is the steady state being checked
+            submit();
+            AllocationCounter::start();
+            submit();
+            size_t allocations = AllocationCounter::stop();
+
+            std::cout << "Allocation check " << mode_name(mode) << ": " << allocations << " allocations for "
+                << FLAT_TASKS / 10 << " tasks " << (allocations == 0 ? "PASS" : "FAIL") << std::endl;
+            passed = passed && allocations == 0;
+        }
+        return passed;
+    }
+
+    // Cost of a single enqueue as seen by the submitting thread, against a mutex + std::queue<std::function> baseline
+    void run_submit_latency() {
+        std::cout << "Submit latency (ns per enqueue, 40 byte capture)\n";
+        std::cout << std::setw(28) << "" << std::setw(10) << "p50" << std::setw(10) << "p99" << std::setw(10) << "max" << "\n";
+
+        std::array<uint64_t, 4> payload = { 1, 2, 3, 4 };
+        std::atomic<uint64_t> sink{ 0 };
+        {
+            std::mutex mutex;
+            std::queue<std::function<void()>> queue;
+            print_latency("std::function + std::queue", measure([&]() {
+                std::lock_guard<std::mutex> lock(mutex);
+                queue.emplace([&sink, payload]() { sink.fetch_add(payload[0], std::memory_order_relaxed); });
+                }, [&]() {
+                    while (!queue.empty()) { queue.front()(); queue.pop(); }
+                }));
+        }
+        for (PoolMode mode : { PoolMode::SharedQueue, PoolMode::WorkStealing }) {
+            ThreadPool pool(topology, node_index, options(mode, 4));
+            print_latency(std::string("Task ") + mode_name(mode), measure([&]() {
+                pool.enqueue([&sink, payload]() { sink.fetch_add(payload[0], std::memory_order_relaxed); });
+                }, [&]() { pool.wait_for_all(); }));
+        }
+    }
+
+private:
+    static constexpr size_t LATENCY_SAMPLES = 100000;
+    static constexpr size_t LATENCY_BATCH = 1000;
+    static constexpr size_t FLAT_TASKS = 200000;
+    static constexpr size_t NESTED_ROOTS = 2000;
+    static constexpr size_t NESTED_CHILDREN = 100;
+
+    const Topology& topology;
+    size_t node_index;
+
+    static const char* mode_name(PoolMode mode) {
+        return mode == PoolMode::SharedQueue ? "SharedQueue" : "WorkStealing";
+    }
+
+    // Time each submit on its own, draining between batches so the queue depth stays realistic
+    template <class Submit, class Drain>
+    static std::vector<double> measure(Submit submit, Drain drain) {
+        std::vector<double> samples;
+        samples.reserve(LATENCY_SAMPLES);
+        while (samples.size() < LATENCY_SAMPLES) {
+            for (size_t i = 0; i < LATENCY_BATCH; ++i) {
+                auto start = std::chrono::high_resolution_clock::now();
+                submit();
+                std::chrono::duration<double, std::nano> duration = std::chrono::high_resolution_clock::now() - start;
+                samples.push_back(duration.count());
+            }
+            drain();
+        }
+        std::sort(samples.begin(), samples.end());
+        return samples;
+    }
+
+    static void print_latency(const std::string& name, const std::vector<double>& sorted) {
+        std::cout << std::setw(28) << name << std::fixed << std::setprecision(0)
+            << std::setw(10) << sorted[sorted.size() / 2]
+            << std::setw(10) << sorted[sorted.size() * 99 / 100]
+            << std::setw(10) << sorted.back() << std::endl;
+    }
+
+    // A little bit of work the compiler can not throw away
+    static void spin(std::atomic<uint64_t>& sink) {
+        uint64_t value = 0;
+        for (uint64_t i = 0; i < 200; ++i)
+            value += i * i;
+        sink.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    ThreadPoolOptions options(PoolMode mode, size_t threads) const {
+        ThreadPoolOptions options;
+        options.num_threads = threads;
+        options.mode = mode;
+        return options;
+    }
+
+    // Every task submitted from the calling thread
+    double flat(PoolMode mode, size_t threads) {
+        ThreadPool pool(topology, node_index, options(mode, threads));
+        std::atomic<uint64_t> sink{ 0 };
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < FLAT_TASKS; ++i)
+            pool.enqueue([&sink]() { spin(sink); });
+        pool.wait_for_all();
+        std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - start;
+        return FLAT_TASKS / duration.count() / 1e6;
+    }
+
+    // A few root tasks that each fan out, the pattern work stealing is built for
+    double nested(PoolMode mode, size_t threads) {
+        ThreadPool pool(topology, node_index, options(mode, threads));
+        std::atomic<uint64_t> sink{ 0 };
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < NESTED_ROOTS; ++i) {
+            pool.enqueue([&pool, &sink]() {
+                for (size_t child = 0; child < NESTED_CHILDREN; ++child)
+                    pool.enqueue([&sink]() { spin(sink); });
+                });
+        }
+        pool.wait_for_all();
+        std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - start;
+        return NESTED_ROOTS * (NESTED_CHILDREN + 1) / duration.count() / 1e6;
+    }
+};
+
+#endif // POOL_BENCHMARK_H
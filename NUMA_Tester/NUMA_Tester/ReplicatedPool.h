@@ -0,0 +1,74 @@
+#ifndef REPLICATED_POOL_H
+#define REPLICATED_POOL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "MemoryAllocator.h"
+#include "Platform.h"
+#include "Topology.h"
+
+// One MemoryAllocator per Node holding the same Frames, for read mostly data such as LUTs and overlays
+// Readers ask for local() and get their own Node's copy, so every read stays on the Node
+// Writes go to one replica and replicate() copies it to the others, the copies only agree after that
+class ReplicatedPool {
+public:
+    // Every replica gets allocator_options.pool_size bytes, bound to its own Node
+    ReplicatedPool(const Topology& topology, const AllocatorOptions& allocator_options = {})
+        : topology(topology) {
+        AllocatorOptions replica_options = allocator_options;
+        replica_options.interleave_nodes.clear();
+        replicas = create_node_allocators(topology, replica_options);
+
+        // Carving follows the same steps on every Node, but a huge page fallback on one of them could change the count
+        num_frames = replicas.front()->getFrames().size();
+        for (const auto& replica : replicas)
+            num_frames = std::min(num_frames, replica->getFrames().size());
+    }
+
+    ReplicatedPool(const ReplicatedPool&) = delete;
+    ReplicatedPool& operator=(const ReplicatedPool&) = delete;
+
+    // The copy on the Node (Topology index)
+    const MemoryAllocator& replica(size_t node) const {
+        return *replicas[node];
+    }
+
+    // The copy on the calling thread's Node
+    const MemoryAllocator& local() const {
+        return replica(topology.node_of_cpu(Platform::current_cpu()));
+    }
+
+    // Frame index of the calling thread's copy
+    std::byte* local_frame(size_t index) const {
+        return local().getFrames()[index];
+    }
+
+    // Frames every replica has
+    size_t get_num_frames() const {
+        return num_frames;
+    }
+
+    // Copy every Frame of from_node's replica over the others, after writing to it
+    void replicate(size_t from_node) {
+        const auto& source = replicas[from_node]->getFrames();
+        const size_t frame_size = replicas[from_node]->get_frame_size();
+        for (size_t node = 0; node < replicas.size(); ++node) {
+            if (node == from_node)
+                continue;
+            const auto& target = replicas[node]->getFrames();
+            for (size_t i = 0; i < num_frames; ++i)
+                std::memcpy(target[i], source[i], frame_size);
+        }
+    }
+
+private:
+    const Topology& topology;
+    std::vector<std::unique_ptr<MemoryAllocator>> replicas;
+    size_t num_frames = 0;
+};
+
+#endif // REPLICATED_POOL_H
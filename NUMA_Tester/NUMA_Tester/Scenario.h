@@ -0,0 +1,341 @@
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// One Thread Node working through (a slice of) one Memory Node's Frames
+// The slice is Frames first, first + stride, ... up to count of them, count 0 means to the end
+struct ScenarioRun {
+    size_t memory_node = 0;
+    size_t thread_node = 0;
+    size_t first = 0;
+    size_t stride = 1;
+    size_t count = 0;
+};
+
+// Whether a Scenario's runs are submitted together or one at a time, each waited for before the next
+enum class Concurrency {
+    Concurrent,
+    Sequential
+};
+
+// One timed block of the tests, expanded from a ScenarioSpec
+struct Scenario {
+    std::string name;
+    std::vector<ScenarioRun> runs;
+    Concurrency concurrency = Concurrency::Concurrent;
+};
+
+// Wall time of one run of a Scenario and the Frame bytes it put through the kernel
+struct ScenarioTiming {
+    double seconds = 0.0;
+    uint64_t bytes = 0;
+};
+
+// Which Thread Node gets which Memory Node's Frames
+enum class Placement {
+    AllPairs,       // Every Memory Node to every Thread Node
+    LocalOnly,      // Each Memory Node to its own Thread Node
+    AllRemote,      // Each Memory Node to every other Thread Node
+    Interleaved,    // Each Memory Node's Frames dealt round robin over the Thread Nodes
+    Custom          // The pairs in mapping
+};
+
+// How many Scenarios one spec becomes
+enum class Expansion {
+    Single,         // One Scenario over both Node sets
+    PerMemoryNode,  // One per Memory Node, against the whole Thread Node set
+    PerThreadNode,  // One per Thread Node, against the whole Memory Node set
+    PerPair         // One per (Memory Node, Thread Node)
+};
+
+// Memory Node set x Thread Node set x placement rule, expanded for however many Nodes the machine has
+// Nodes are Topology indices, an empty set means every Node
+// Memory Nodes past the last Topology index are the extra pools (interleaved, replicated), only used when named
+// {m} and {t} in the name are replaced by the Memory and Thread Node of each expanded Scenario
+struct ScenarioSpec {
+    std::string name;
+    std::vector<size_t> memory_nodes;
+    std::vector<size_t> thread_nodes;
+    Placement placement = Placement::AllPairs;
+    std::vector<std::pair<size_t, size_t>> mapping;     // Placement::Custom, (Memory Node, Thread Node)
+    Expansion expansion = Expansion::Single;
+    size_t frames = 0;                                  // Frames per Memory Node per run, 0 for all of them
+    Concurrency concurrency = Concurrency::Concurrent;
+};
+
+namespace ScenarioEngine {
+
+    // The blocks the tests have always run, then the ones that only make sense past two Nodes
+    //   mem{m}_thr{t}    every Memory Node against every Thread Node on its own, BEST and WORST per pair
+    //   all_general      every pair at once, the general case with everything running
+    //   mem{m}_all       one Memory Node against every Thread Node at once, WORST case per Memory Node
+    //   all_best         each Memory Node against its own Thread Node, BEST case with all cores running
+    //   all_worst        each Memory Node against every other Thread Node, WORST case with all cores running
+    //   thr{t}_all       one Thread Node against every Memory Node at once
+    //   all_interleaved  every Memory Node's Frames spread evenly over every Thread Node
+    // and for each extra pool (memory index num_nodes + k)
+    //   {m}_all          the pool against every Thread Node at once, the ALL GENERAL load on shared memory
+    //   {m}_thr{t}       the pool against one Thread Node
+    inline std::vector<ScenarioSpec> default_specs(size_t num_nodes = 0, const std::vector<std::string>& extra_memory = {}) {
+        std::vector<ScenarioSpec> specs(7);
+        specs[0].name = "mem{m}_thr{t}";
+        specs[0].expansion = Expansion::PerPair;
+        specs[1].name = "all_general";
+        specs[2].name = "mem{m}_all";
+        specs[2].expansion = Expansion::PerMemoryNode;
+        specs[3].name = "all_best";
+        specs[3].placement = Placement::LocalOnly;
+        specs[4].name = "all_worst";
+        specs[4].placement = Placement::AllRemote;
+        specs[5].name = "thr{t}_all";
+        specs[5].expansion = Expansion::PerThreadNode;
+        specs[6].name = "all_interleaved";
+        specs[6].placement = Placement::Interleaved;
+        for (size_t extra = 0; extra < extra_memory.size(); ++extra) {
+            ScenarioSpec all;
+            all.name = "{m}_all";
+            all.memory_nodes = { num_nodes + extra };
+            specs.push_back(all);
+            ScenarioSpec per_thread = all;
+            per_thread.name = "{m}_thr{t}";
+            per_thread.expansion = Expansion::PerThreadNode;
+            specs.push_back(per_thread);
+        }
+        return specs;
+    }
+
+    // "0", "1", ... for the Topology Nodes, the pool name for the extra pools
+    inline std::string memory_name(size_t memory_node, size_t num_nodes, const std::vector<std::string>& extra_memory) {
+        return memory_node < num_nodes ? std::to_string(memory_node) : extra_memory[memory_node - num_nodes];
+    }
+
+    inline std::string substitute(std::string name, const char* key, const std::string& value) {
+        for (size_t at = name.find(key); at != std::string::npos; at = name.find(key, at + value.size()))
+            name.replace(at, 3, value);
+        return name;
+    }
+
+    // Runs of the placement rule over the two Node sets
+    inline std::vector<ScenarioRun> place(const ScenarioSpec& spec, const std::vector<size_t>& memory, const std::vector<size_t>& threads) {
+        std::vector<ScenarioRun> runs;
+        for (size_t m : memory) {
+            for (size_t k = 0; k < threads.size(); ++k) {
+                const size_t t = threads[k];
+                switch (spec.placement) {
+                case Placement::AllPairs:
+                    runs.push_back({ m, t, 0, 1, spec.frames });
+                    break;
+                case Placement::LocalOnly:
+                    if (m == t)
+                        runs.push_back({ m, t, 0, 1, spec.frames });
+                    break;
+                case Placement::AllRemote:
+                    if (m != t)
+                        runs.push_back({ m, t, 0, 1, spec.frames });
+                    break;
+                case Placement::Interleaved:
+                    // Thread Node k of n takes Frames k, k + n, ... so each gets 1/n of the share
+                    runs.push_back({ m, t, k, threads.size(), spec.frames ? (spec.frames + threads.size() - 1 - k) / threads.size() : 0 });
+                    break;
+                case Placement::Custom:
+                    if (std::find(spec.mapping.begin(), spec.mapping.end(), std::pair<size_t, size_t>(m, t)) != spec.mapping.end())
+                        runs.push_back({ m, t, 0, 1, spec.frames });
+                    break;
+                }
+            }
+        }
+        return runs;
+    }
+
+    // Every Scenario the spec stands for on a machine with num_nodes Nodes, ones with nothing to run are left out
+    // extra_memory names the extra pools, which only take part where the spec names them, in memory= or in map=
+    inline std::vector<Scenario> expand(const ScenarioSpec& spec, size_t num_nodes, const std::vector<std::string>& extra_memory = {}) {
+        auto resolve = [num_nodes](const std::vector<size_t>& set, size_t limit) {
+            std::vector<size_t> nodes;
+            for (size_t node = 0; node < (set.empty() ? num_nodes : limit); ++node) {
+                if (set.empty() || std::find(set.begin(), set.end(), node) != set.end())
+                    nodes.push_back(node);
+            }
+            return nodes;
+        };
+        std::vector<size_t> memory = resolve(spec.memory_nodes, num_nodes + extra_memory.size());
+        if (spec.placement == Placement::Custom && spec.memory_nodes.empty()) {
+            for (const auto& [m, t] : spec.mapping) {
+                if (m >= num_nodes && m < num_nodes + extra_memory.size() && std::find(memory.begin(), memory.end(), m) == memory.end())
+                    memory.push_back(m);
+            }
+            std::sort(memory.begin(), memory.end());
+        }
+        const std::vector<size_t> threads = resolve(spec.thread_nodes, num_nodes);
+
+        // The (Memory set, Thread set) of each expanded Scenario
+        std::vector<std::pair<std::vector<size_t>, std::vector<size_t>>> parts;
+        switch (spec.expansion) {
+        case Expansion::Single:
+            parts.push_back({ memory, threads });
+            break;
+        case Expansion::PerMemoryNode:
+            for (size_t m : memory)
+                parts.push_back({ { m }, threads });
+            break;
+        case Expansion::PerThreadNode:
+            for (size_t t : threads)
+                parts.push_back({ memory, { t } });
+            break;
+        case Expansion::PerPair:
+            for (size_t m : memory) {
+                for (size_t t : threads)
+                    parts.push_back({ { m }, { t } });
+            }
+            break;
+        }
+
+        // Expanded names have to stay unique, add the placeholder the spec left out
+        std::string name = spec.name;
+        if ((spec.expansion == Expansion::PerMemoryNode || spec.expansion == Expansion::PerPair) && name.find("{m}") == std::string::npos)
+            name += "_mem{m}";
+        if ((spec.expansion == Expansion::PerThreadNode || spec.expansion == Expansion::PerPair) && name.find("{t}") == std::string::npos)
+            name += "_thr{t}";
+
+        std::vector<Scenario> scenarios;
+        for (const auto& [memory_part, thread_part] : parts) {
+            Scenario scenario;
+            scenario.name = name;
+            if (memory_part.size() == 1)
+                scenario.name = substitute(scenario.name, "{m}", memory_name(memory_part.front(), num_nodes, extra_memory));
+            if (thread_part.size() == 1)
+                scenario.name = substitute(scenario.name, "{t}", std::to_string(thread_part.front()));
+            scenario.runs = place(spec, memory_part, thread_part);
+            scenario.concurrency = spec.concurrency;
+            if (!scenario.runs.empty())
+                scenarios.push_back(scenario);
+        }
+        return scenarios;
+    }
+
+    // Node indices or all, extra_memory names (for the memory set) stand for num_nodes + their position
+    inline bool parse_nodes(const std::string& text, size_t num_nodes, std::vector<size_t>& nodes, const std::vector<std::string>& extra_memory = {}) {
+        nodes.clear();
+        if (text == "all")
+            return true;
+        std::stringstream stream(text);
+        std::string item;
+        while (std::getline(stream, item, ',')) {
+            auto extra = std::find(extra_memory.begin(), extra_memory.end(), item);
+            if (extra != extra_memory.end()) {
+                nodes.push_back(num_nodes + static_cast<size_t>(extra - extra_memory.begin()));
+                continue;
+            }
+            try {
+                size_t node = std::stoul(item);
+                if (node >= num_nodes)
+                    return false;
+                nodes.push_back(node);
+            }
+            catch (const std::exception&) {
+                return false;
+            }
+        }
+        return !nodes.empty();
+    }
+
+    // name:key=value:key=value..., for example
+    //   far_reads:memory=0:threads=2,3:placement=remote:expand=thread:frames=100:run=sequential
+    //   ring:map=0>1,1>2,2>3,3>0
+    // memory=, threads=   Node indices or all (the default), memory= also takes the extra pool names
+    // placement=          pairs (default), local, remote, interleaved
+    // map=m>t,...         custom placement with exactly those pairs
+    // expand=             single (default), memory, thread, pair
+    // frames=N            Frames per Memory Node per run, 0 (default) for all of them
+    // run=                concurrent (default) or sequential
+    // Returns false with error set if the text does not parse or names a Node past num_nodes
+    inline bool parse(const std::string& text, size_t num_nodes, ScenarioSpec& spec, std::string& error,
+        const std::vector<std::string>& extra_memory = {}) {
+        spec = ScenarioSpec();
+        std::stringstream stream(text);
+        std::string field;
+        std::getline(stream, spec.name, ':');
+        if (spec.name.empty()) {
+            error = "missing scenario name in '" + text + "'";
+            return false;
+        }
+        while (std::getline(stream, field, ':')) {
+            const size_t equals = field.find('=');
+            const std::string key = field.substr(0, equals);
+            const std::string value = equals == std::string::npos ? "" : field.substr(equals + 1);
+            bool ok = true;
+            if (key == "memory")
+                ok = parse_nodes(value, num_nodes, spec.memory_nodes, extra_memory);
+            else if (key == "threads")
+                ok = parse_nodes(value, num_nodes, spec.thread_nodes);
+            else if (key == "placement") {
+                if (value == "pairs") spec.placement = Placement::AllPairs;
+                else if (value == "local") spec.placement = Placement::LocalOnly;
+                else if (value == "remote") spec.placement = Placement::AllRemote;
+                else if (value == "interleaved") spec.placement = Placement::Interleaved;
+                else ok = false;
+            }
+            else if (key == "map") {
+                spec.placement = Placement::Custom;
+                std::stringstream pairs(value);
+                std::string pair;
+                while (ok && std::getline(pairs, pair, ',')) {
+                    const size_t arrow = pair.find('>');
+                    std::vector<size_t> m, t;
+                    ok = arrow != std::string::npos && parse_nodes(pair.substr(0, arrow), num_nodes, m, extra_memory) && m.size() == 1
+                        && parse_nodes(pair.substr(arrow + 1), num_nodes, t) && t.size() == 1;
+                    if (ok)
+                        spec.mapping.push_back({ m.front(), t.front() });
+                }
+                ok = ok && !spec.mapping.empty();
+            }
+            else if (key == "expand") {
+                if (value == "single") spec.expansion = Expansion::Single;
+                else if (value == "memory") spec.expansion = Expansion::PerMemoryNode;
+                else if (value == "thread") spec.expansion = Expansion::PerThreadNode;
+                else if (value == "pair") spec.expansion = Expansion::PerPair;
+                else ok = false;
+            }
+            else if (key == "frames") {
+                try {
+                    spec.frames = std::stoul(value);
+                }
+                catch (const std::exception&) {
+                    ok = false;
+                }
+            }
+            else if (key == "run") {
+                if (value == "concurrent") spec.concurrency = Concurrency::Concurrent;
+                else if (value == "sequential") spec.concurrency = Concurrency::Sequential;
+                else ok = false;
+            }
+            else
+                ok = false;
+
+            if (!ok) {
+                error = "bad '" + field + "' in scenario '" + text + "'";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // All the runs of the Scenarios as one, for running them at the same time
+    inline Scenario combine(const std::vector<Scenario>& scenarios) {
+        Scenario combined;
+        for (const Scenario& scenario : scenarios) {
+            combined.name += (combined.name.empty() ? "" : "+") + scenario.name;
+            combined.runs.insert(combined.runs.end(), scenario.runs.begin(), scenario.runs.end());
+        }
+        return combined;
+    }
+}
+
+#endif // SCENARIO_H
@@ -0,0 +1,72 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include "Constants.h"
+
+// Bounded lock free ring for exactly one producer thread and one consumer thread
+// Head and tail sit on their own cache lines and each side keeps a copy of the other's index,
+// so the shared line is only read again when the ring looks full (producer) or empty (consumer)
+template <class T>
+class SpscRing {
+public:
+    // Capacity is rounded up to a power of two
+    explicit SpscRing(size_t capacity) {
+        size_t rounded = 1;
+        while (rounded < capacity)
+            rounded <<= 1;
+        slots = std::make_unique<T[]>(rounded);
+        mask = rounded - 1;
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Producer only, false if the ring is full
+    bool try_push(T value) {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head_cache > mask) {
+            head_cache = head.load(std::memory_order_acquire);
+            if (t - head_cache > mask)
+                return false;
+        }
+        slots[t & mask] = std::move(value);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only, false if the ring is empty
+    bool try_pop(T& value) {
+        const size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail_cache) {
+            tail_cache = tail.load(std::memory_order_acquire);
+            if (h == tail_cache)
+                return false;
+        }
+        value = std::move(slots[h & mask]);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Items in the ring, exact from either end's own thread, a snapshot from anywhere else
+    size_t size() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const {
+        return mask + 1;
+    }
+
+private:
+    std::unique_ptr<T[]> slots;
+    size_t mask = 0;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> head{ 0 };    // Written by the consumer
+    size_t tail_cache = 0;                                      // Consumer's copy of tail
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail{ 0 };    // Written by the producer
+    size_t head_cache = 0;                                      // Producer's copy of head
+};
+
+#endif // SPSC_RING_H
@@ -0,0 +1,209 @@
+#ifndef STREAM_BENCHMARK_H
+#define STREAM_BENCHMARK_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "FrameKernels.h"
+#include "FramePool.h"
+#include "ThreadPool.h"
+#include "Topology.h"
+
+struct StreamOptions {
+    double fps = 60.0;              // Frames per second of every stream
+    double seconds = 2.0;           // How long each run releases Frames
+    double deadline_frames = 1.0;   // A Frame is late if it is not done this many frame periods after its release
+    size_t buffers = 2;             // Frames per stream, a release finding all of them still in flight is dropped
+    size_t node = 0;                // Topology Node the streams' Frames and work live on
+    double miss_tolerance = 0.001;  // Late + dropped share a stream count may have and still pass the sweep
+    size_t max_streams = 256;       // Sweep limit
+};
+
+struct StreamResult {
+    size_t streams = 0;
+    uint64_t released = 0;      // Release times that came up
+    uint64_t completed = 0;     // Frames run, late ones included
+    uint64_t late = 0;          // Completed after their deadline
+    uint64_t dropped = 0;       // Release found no free buffer, the stream skipped the Frame
+    double p50 = 0.0;           // Release -> done latency in ms
+    double p99 = 0.0;
+    double p999 = 0.0;
+    double max = 0.0;
+    double jitter = 0.0;        // Mean change in latency between a stream's consecutive Frames (RFC 3550 style), ms
+    bool out_of_frames = false; // The Node pool could not give every stream its buffers
+
+    double miss_rate() const {
+        return released ? static_cast<double>(late + dropped) / released : 0.0;
+    }
+};
+
+// Live streams rather than a batch: every stream releases a Frame every 1/fps seconds, phase shifted from the others,
+// onto the Node's ThreadPool, and each Frame has to be done within its deadline
+// One pacing thread releases for every stream, so the pool sees the arrival pattern of N cameras
+// The sweep adds streams until the late + dropped share passes the tolerance, the last count that passed
+// is the streams one socket can carry
+class StreamBenchmark {
+public:
+    StreamBenchmark(FramePool& frame_pool, ThreadPool& thread_pool, FrameKernel kernel, size_t frame_size, const StreamOptions& options = {})
+        : frame_pool(frame_pool), thread_pool(thread_pool), kernel(kernel), frame_size(frame_size), options(options) {
+    }
+
+    StreamResult run(size_t num_streams) {
+        StreamResult result;
+        result.streams = num_streams;
+        const size_t frames_per_stream = static_cast<size_t>(options.fps * options.seconds);
+        const uint64_t period_ns = static_cast<uint64_t>(1e9 / options.fps);
+        const uint64_t deadline_ns = static_cast<uint64_t>(options.deadline_frames * period_ns);
+
+        // Each stream's buffers, held for the whole run
+        std::vector<Stream> streams(num_streams);
+        std::vector<FrameLease> leases;
+        for (auto& stream : streams) {
+            stream.buffers = std::make_unique<Buffer[]>(options.buffers);
+            for (size_t b = 0; b < options.buffers; ++b) {
+                FrameLease lease = frame_pool.acquire(options.node);
+                if (!lease || lease.get_node() != options.node) {
+                    result.out_of_frames = true;
+                    return result;
+                }
+                stream.buffers[b].frame = lease.data();
+                leases.push_back(std::move(lease));
+            }
+            stream.latency_ns.assign(frames_per_stream, UINT64_MAX);
+        }
+
+        // Release k of stream s is due at start + k * period + s * period / streams
+        const uint64_t start = now_ns() + period_ns;
+        for (size_t k = 0; k < frames_per_stream; ++k) {
+            for (size_t s = 0; s < num_streams; ++s) {
+                const uint64_t release = start + k * period_ns + s * period_ns / num_streams;
+                wait_until(release);
+                ++result.released;
+
+                Stream& stream = streams[s];
+                Buffer& buffer = stream.buffers[stream.next % options.buffers];
+                if (buffer.busy.load(std::memory_order_acquire)) {
+                    ++result.dropped;
+                    continue;
+                }
+                ++stream.next;
+                buffer.busy.store(true, std::memory_order_relaxed);
+                uint64_t* latency = &stream.latency_ns[k];
+                thread_pool.enqueue([&buffer, latency, release, frame_kernel = kernel, size = frame_size]() {
+                    frame_kernel(buffer.frame, size);
+                    *latency = now_ns() - release;
+                    buffer.busy.store(false, std::memory_order_release);
+                    });
+            }
+        }
+        thread_pool.wait_for_all();
+
+        std::vector<uint64_t> all;
+        double jitter_sum = 0.0;
+        uint64_t jitter_count = 0;
+        for (const auto& stream : streams) {
+            uint64_t previous = UINT64_MAX;
+            for (uint64_t latency : stream.latency_ns) {
+                if (latency == UINT64_MAX)
+                    continue;
+                all.push_back(latency);
+                if (latency > deadline_ns)
+                    ++result.late;
+                if (previous != UINT64_MAX) {
+                    jitter_sum += std::fabs(static_cast<double>(latency) - static_cast<double>(previous));
+                    ++jitter_count;
+                }
+                previous = latency;
+            }
+        }
+        result.completed = all.size();
+        if (!all.empty()) {
+            std::sort(all.begin(), all.end());
+            auto percentile = [&all](double fraction) {
+                return all[std::min(all.size() - 1, static_cast<size_t>(std::ceil(fraction * all.size())) - 1)] / 1e6;
+            };
+            result.p50 = percentile(0.50);
+            result.p99 = percentile(0.99);
+            result.p999 = percentile(0.999);
+            result.max = all.back() / 1e6;
+        }
+        result.jitter = jitter_count ? jitter_sum / jitter_count / 1e6 : 0.0;
+        return result;
+    }
+
+    // 1, 2, 3, ... streams until one misses, returns the last count that passed (0 if even one stream failed)
+    size_t sweep(std::ostream& os) {
+        print_header(os);
+        size_t passed = 0;
+        for (size_t streams = 1; streams <= options.max_streams; ++streams) {
+            StreamResult result = run(streams);
+            if (result.out_of_frames) {
+                os << "Out of Frames on Node " << options.node << " for " << streams << " streams of " << options.buffers
+                    << " buffers, the pool limits the count before the deadlines do" << std::endl;
+                break;
+            }
+            print(result, os);
+            if (result.miss_rate() > options.miss_tolerance)
+                break;
+            passed = streams;
+        }
+        os << "Max streams on Node " << options.node << " at " << options.fps << " fps: " << passed << std::endl;
+        return passed;
+    }
+
+    static void print_header(std::ostream& os) {
+        os << std::setw(8) << "Streams" << std::setw(10) << "Released" << std::setw(8) << "Late" << std::setw(9) << "Dropped"
+            << std::setw(10) << "p50 ms" << std::setw(10) << "p99 ms" << std::setw(10) << "p99.9 ms" << std::setw(10) << "max ms"
+            << std::setw(11) << "Jitter ms" << std::setw(9) << "Miss %" << "\n";
+    }
+
+    static void print(const StreamResult& result, std::ostream& os) {
+        os << std::setw(8) << result.streams << std::setw(10) << result.released << std::setw(8) << result.late
+            << std::setw(9) << result.dropped << std::fixed << std::setprecision(3)
+            << std::setw(10) << result.p50 << std::setw(10) << result.p99 << std::setw(10) << result.p999 << std::setw(10) << result.max
+            << std::setw(11) << result.jitter << std::setprecision(2) << std::setw(9) << result.miss_rate() * 100 << std::endl;
+    }
+
+private:
+    // A Frame of a stream, busy from release until its Task is done
+    struct alignas(CACHE_LINE_SIZE) Buffer {
+        std::byte* frame = nullptr;
+        std::atomic<bool> busy{ false };
+    };
+
+    struct Stream {
+        std::unique_ptr<Buffer[]> buffers;
+        size_t next = 0;
+        std::vector<uint64_t> latency_ns;   // Per release, UINT64_MAX if it was dropped; each slot has one writer
+    };
+
+    FramePool& frame_pool;
+    ThreadPool& thread_pool;
+    FrameKernel kernel;
+    size_t frame_size;
+    StreamOptions options;
+
+    static uint64_t now_ns() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // Sleep most of the way, then yield, the OS sleep alone overshoots by tens of microseconds
+    static void wait_until(uint64_t when) {
+        const uint64_t now = now_ns();
+        if (when > now + 200000)
+            std::this_thread::sleep_for(std::chrono::nanoseconds(when - now - 100000));
+        while (now_ns() < when)
+            std::this_thread::yield();
+    }
+};
+
+#endif // STREAM_BENCHMARK_H
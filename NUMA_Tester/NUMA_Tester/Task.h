@@ -0,0 +1,176 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Move-only void() callable stored inline, it never touches the heap
+// Captures must fit in INLINE_SIZE bytes, which is checked at compile time so an oversized lambda
+// is a build error rather than a hidden allocation on the hot path
+class Task {
+public:
+    static constexpr size_t INLINE_SIZE = 48; // A Task is one cache line: storage + ops pointer + enqueue time
+
+    Task() = default;
+
+    template <class F, class = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Task>>>
+    Task(F&& f) {
+        using Fn = std::decay_t<F>;
+        static_assert(sizeof(Fn) <= INLINE_SIZE, "Task capture too big, capture pointers or grow Task::INLINE_SIZE");
+        static_assert(alignof(Fn) <= alignof(std::max_align_t), "Task capture is over aligned");
+        static_assert(std::is_nothrow_move_constructible_v<Fn>, "Task captures must be nothrow movable");
+        ::new (static_cast<void*>(storage)) Fn(std::forward<F>(f));
+        ops = &ops_for<Fn>;
+    }
+
+    Task(Task&& other) noexcept {
+        take(other);
+    }
+
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            take(other);
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() {
+        reset();
+    }
+
+    explicit operator bool() const {
+        return ops != nullptr;
+    }
+
+    void operator()() {
+        ops->invoke(storage);
+    }
+
+    void reset() {
+        if (ops) {
+            ops->destroy(storage);
+            ops = nullptr;
+        }
+    }
+
+    // When the Task was queued, in Telemetry::now_ns() time, 0 if nobody stamped it
+    // Lives in what would otherwise be padding, so it costs no space
+    uint64_t get_enqueue_time() const {
+        return enqueued_ns;
+    }
+
+    void set_enqueue_time(uint64_t ns) {
+        enqueued_ns = ns;
+    }
+
+private:
+    struct Ops {
+        void (*invoke)(void*);
+        void (*move)(void* to, void* from);
+        void (*destroy)(void*);
+    };
+
+    template <class Fn>
+    static constexpr Ops ops_for = {
+        [](void* self) { (*static_cast<Fn*>(self))(); },
+        [](void* to, void* from) { ::new (to) Fn(std::move(*static_cast<Fn*>(from))); static_cast<Fn*>(from)->~Fn(); },
+        [](void* self) { static_cast<Fn*>(self)->~Fn(); }
+    };
+
+    alignas(std::max_align_t) unsigned char storage[INLINE_SIZE];
+    const Ops* ops = nullptr;
+    uint64_t enqueued_ns = 0;
+
+    void take(Task& other) {
+        enqueued_ns = other.enqueued_ns;
+        if (other.ops) {
+            other.ops->move(storage, other.storage);
+            ops = other.ops;
+            other.ops = nullptr;
+        }
+    }
+};
+
+// Double ended ring of Tasks with preallocated capacity
+// Grows by doubling only when full, so once it has seen its working depth push and pop never allocate
+// Not synchronized, the owner provides the lock
+class TaskRing {
+public:
+    explicit TaskRing(size_t initial_capacity = 1024) {
+        size_t capacity = 1;
+        while (capacity < initial_capacity)
+            capacity <<= 1;
+        slots = std::make_unique<Task[]>(capacity);
+        mask = capacity - 1;
+    }
+
+    bool empty() const {
+        return head == tail;
+    }
+
+    size_t size() const {
+        return tail - head;
+    }
+
+    size_t capacity() const {
+        return mask + 1;
+    }
+
+    // Both return the queued Task so the caller can stamp it
+    template <class F>
+    Task& emplace_back(F&& f) {
+        if (size() == capacity())
+            grow();
+        Task& slot = slots[tail++ & mask];
+        slot = Task(std::forward<F>(f));
+        return slot;
+    }
+
+    Task& push_back(Task&& task) {
+        if (size() == capacity())
+            grow();
+        Task& slot = slots[tail++ & mask];
+        slot = std::move(task);
+        return slot;
+    }
+
+    // Oldest task, FIFO order
+    Task pop_front() {
+        Task task = std::move(slots[head & mask]);
+        ++head;
+        return task;
+    }
+
+    // Newest task, LIFO order
+    Task pop_back() {
+        --tail;
+        return std::move(slots[tail & mask]);
+    }
+
+private:
+    std::unique_ptr<Task[]> slots;
+    size_t mask = 0;
+    size_t head = 0;    // Monotonic, index with & mask
+    size_t tail = 0;
+
+    void grow() {
+        const size_t old_capacity = capacity();
+        auto bigger = std::make_unique<Task[]>(old_capacity * 2);
+        for (size_t i = 0; i < old_capacity; ++i)
+            bigger[i] = std::move(slots[(head + i) & mask]);
+        slots = std::move(bigger);
+        mask = old_capacity * 2 - 1;
+        tail = old_capacity;
+        head = 0;
+    }
+};
+
+#endif // TASK_H
@@ -0,0 +1,250 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Constants.h"
+
+// ThreadPool instrumentation, on unless built with THREAD_POOL_TELEMETRY=0
+// When off the recording calls are discarded at compile time and the pools keep no telemetry state
+#ifndef THREAD_POOL_TELEMETRY
+#define THREAD_POOL_TELEMETRY 1
+#endif
+
+namespace Telemetry {
+
+    constexpr bool ENABLED = THREAD_POOL_TELEMETRY != 0;
+
+    inline uint64_t now_ns() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // Single writer counters: only the owning thread stores, anyone may load
+    // A plain load + store is enough and keeps the lock prefix off the hot path
+    inline void bump(std::atomic<uint64_t>& counter, uint64_t amount = 1) {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    // Log linear buckets in the HDR histogram style: every power of two is split into SUB_BUCKETS,
+    // so a bucket is never wider than 1/16 of its value, from 1 ns up to 2^MAX_BITS ns (over an hour)
+    constexpr unsigned SUB_BITS = 4;
+    constexpr uint64_t SUB_BUCKETS = 1ULL << SUB_BITS;
+    constexpr unsigned MAX_BITS = 42;
+    constexpr size_t BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_BUCKETS;
+
+    inline size_t bucket_of(uint64_t value) {
+        value = std::min<uint64_t>(value, (1ULL << MAX_BITS) - 1);
+        if (value < SUB_BUCKETS)
+            return static_cast<size_t>(value);
+        const unsigned shift = static_cast<unsigned>(std::bit_width(value)) - 1 - SUB_BITS;
+        return static_cast<size_t>((shift + 1) * SUB_BUCKETS + ((value >> shift) - SUB_BUCKETS));
+    }
+
+    // Highest value that lands in the bucket
+    inline uint64_t bucket_value(size_t bucket) {
+        if (bucket < SUB_BUCKETS)
+            return bucket;
+        const unsigned shift = static_cast<unsigned>(bucket / SUB_BUCKETS) - 1;
+        return ((SUB_BUCKETS + bucket % SUB_BUCKETS + 1) << shift) - 1;
+    }
+
+    // Copy of a histogram that can be merged, diffed and queried, values in ns
+    struct HistogramSnapshot {
+        std::array<uint64_t, BUCKETS> counts{};
+        uint64_t sum = 0;
+
+        uint64_t count() const {
+            uint64_t total = 0;
+            for (uint64_t bucket : counts)
+                total += bucket;
+            return total;
+        }
+
+        // Smallest recorded value that fraction (0.99 for p99) of the samples are at or below, 0 if empty
+        uint64_t percentile(double fraction) const {
+            const uint64_t total = count();
+            if (total == 0)
+                return 0;
+            const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(fraction * total + 0.5));
+            uint64_t seen = 0;
+            for (size_t i = 0; i < BUCKETS; ++i) {
+                seen += counts[i];
+                if (seen >= rank)
+                    return bucket_value(i);
+            }
+            return bucket_value(BUCKETS - 1);
+        }
+
+        uint64_t max() const {
+            for (size_t i = BUCKETS; i-- > 0; ) {
+                if (counts[i])
+                    return bucket_value(i);
+            }
+            return 0;
+        }
+
+        double mean() const {
+            const uint64_t total = count();
+            return total ? static_cast<double>(sum) / total : 0.0;
+        }
+
+        HistogramSnapshot& operator+=(const HistogramSnapshot& other) {
+            for (size_t i = 0; i < BUCKETS; ++i)
+                counts[i] += other.counts[i];
+            sum += other.sum;
+            return *this;
+        }
+
+        // Leaves what was recorded after the earlier snapshot
+        HistogramSnapshot& operator-=(const HistogramSnapshot& earlier) {
+            for (size_t i = 0; i < BUCKETS; ++i)
+                counts[i] -= earlier.counts[i];
+            sum -= earlier.sum;
+            return *this;
+        }
+    };
+
+    // Lock free, single writer histogram, snapshot() may run on any thread at any time
+    // A snapshot taken while recording can be one sample behind in the sum, never torn in a bucket
+    class LatencyHistogram {
+    public:
+        void record(uint64_t value) {
+            bump(counts[bucket_of(value)]);
+            bump(sum, value);
+        }
+
+        HistogramSnapshot snapshot() const {
+            HistogramSnapshot copy;
+            for (size_t i = 0; i < BUCKETS; ++i)
+                copy.counts[i] = counts[i].load(std::memory_order_relaxed);
+            copy.sum = sum.load(std::memory_order_relaxed);
+            return copy;
+        }
+
+    private:
+        std::array<std::atomic<uint64_t>, BUCKETS> counts{};
+        std::atomic<uint64_t> sum{ 0 };
+    };
+
+    // Everything one pool thread has recorded, as plain numbers
+    struct WorkerSnapshot {
+        uint64_t tasks = 0;             // Tasks run
+        uint64_t items = 0;             // parallel_for chunks run
+        uint64_t steals = 0;            // Tasks taken from another thread of the same pool
+        uint64_t remote_steals = 0;     // Tasks taken from another Node's pool
+        uint64_t wakeups = 0;           // Times the thread went to sleep and was woken
+        uint64_t busy_ns = 0;           // Time inside Tasks
+        uint64_t idle_ns = 0;           // Time asleep waiting for work
+        HistogramSnapshot queue_wait;   // Task enqueue -> start
+        HistogramSnapshot run_time;     // Task start -> finish
+        HistogramSnapshot item_wait;    // parallel_for call -> chunk start
+        HistogramSnapshot item_run;     // Chunk start -> finish
+        HistogramSnapshot wakeup;       // Work published -> sleeping thread running again
+
+        // Fraction of the observed time spent in Tasks
+        double utilization() const {
+            const uint64_t total = busy_ns + idle_ns;
+            return total ? static_cast<double>(busy_ns) / total : 0.0;
+        }
+
+        WorkerSnapshot& operator+=(const WorkerSnapshot& other) {
+            tasks += other.tasks;
+            items += other.items;
+            steals += other.steals;
+            remote_steals += other.remote_steals;
+            wakeups += other.wakeups;
+            busy_ns += other.busy_ns;
+            idle_ns += other.idle_ns;
+            queue_wait += other.queue_wait;
+            run_time += other.run_time;
+            item_wait += other.item_wait;
+            item_run += other.item_run;
+            wakeup += other.wakeup;
+            return *this;
+        }
+
+        WorkerSnapshot& operator-=(const WorkerSnapshot& earlier) {
+            tasks -= earlier.tasks;
+            items -= earlier.items;
+            steals -= earlier.steals;
+            remote_steals -= earlier.remote_steals;
+            wakeups -= earlier.wakeups;
+            busy_ns -= earlier.busy_ns;
+            idle_ns -= earlier.idle_ns;
+            queue_wait -= earlier.queue_wait;
+            run_time -= earlier.run_time;
+            item_wait -= earlier.item_wait;
+            item_run -= earlier.item_run;
+            wakeup -= earlier.wakeup;
+            return *this;
+        }
+    };
+
+    // One pool's threads, in thread order
+    struct PoolSnapshot {
+        std::vector<WorkerSnapshot> workers;
+
+        WorkerSnapshot total() const {
+            WorkerSnapshot sum;
+            for (const auto& worker : workers)
+                sum += worker;
+            return sum;
+        }
+
+        // What happened between earlier and this snapshot of the same pool
+        PoolSnapshot since(const PoolSnapshot& earlier) const {
+            PoolSnapshot delta = *this;
+            for (size_t i = 0; i < std::min(delta.workers.size(), earlier.workers.size()); ++i)
+                delta.workers[i] -= earlier.workers[i];
+            return delta;
+        }
+    };
+
+    // Recorded by one pool thread only, one per thread on its own cache lines
+    struct alignas(CACHE_LINE_SIZE) WorkerTelemetry {
+        std::atomic<uint64_t> tasks{ 0 };
+        std::atomic<uint64_t> items{ 0 };
+        std::atomic<uint64_t> steals{ 0 };
+        std::atomic<uint64_t> remote_steals{ 0 };
+        std::atomic<uint64_t> wakeups{ 0 };
+        std::atomic<uint64_t> busy_ns{ 0 };
+        std::atomic<uint64_t> idle_ns{ 0 };
+        LatencyHistogram queue_wait;
+        LatencyHistogram run_time;
+        LatencyHistogram item_wait;
+        LatencyHistogram item_run;
+        LatencyHistogram wakeup;
+
+        WorkerSnapshot snapshot() const {
+            WorkerSnapshot copy;
+            copy.tasks = tasks.load(std::memory_order_relaxed);
+            copy.items = items.load(std::memory_order_relaxed);
+            copy.steals = steals.load(std::memory_order_relaxed);
+            copy.remote_steals = remote_steals.load(std::memory_order_relaxed);
+            copy.wakeups = wakeups.load(std::memory_order_relaxed);
+            copy.busy_ns = busy_ns.load(std::memory_order_relaxed);
+            copy.idle_ns = idle_ns.load(std::memory_order_relaxed);
+            copy.queue_wait = queue_wait.snapshot();
+            copy.run_time = run_time.snapshot();
+            copy.item_wait = item_wait.snapshot();
+            copy.item_run = item_run.snapshot();
+            copy.wakeup = wakeup.snapshot();
+            return copy;
+        }
+    };
+
+    // The calling pool thread's record, null on threads that are not pool threads
+    inline WorkerTelemetry*& current() {
+        static thread_local WorkerTelemetry* telemetry = nullptr;
+        return telemetry;
+    }
+}
+
+#endif // TELEMETRY_H
@@ -3,43 +3,113 @@
 
 #include <vector>
 #include <thread>
-#include <queue>
-#include <functional>
 #include <mutex>
 #include <condition_variable>
-#include <windows.h>
+#include <coroutine>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <iterator>
+#include <type_traits>
+#include <cstdint>
+#include <iostream>
+#include "Constants.h"
+#include "Task.h"
+#include "Telemetry.h"
+#include "Platform.h"
+#include "Topology.h"
+
+// How the ThreadPool hands out work
+enum class PoolMode {
+    SharedQueue,    // One locked queue for all the threads
+    WorkStealing    // A deque per thread, idle threads steal from their neighbours
+};
+
+// Where an idle WorkStealing thread may look for work
+enum class StealPolicy {
+    NodeLocal,      // Only threads in the same Node
+    AllowRemote     // Then the other Nodes' pools, nearest first (see set_remote_pools)
+};
+
+struct ThreadPoolOptions {
+    size_t num_threads = 0;     // 0 means one thread per logical CPU in the Node
+    PoolMode mode = PoolMode::SharedQueue;
+    StealPolicy steal_policy = StealPolicy::NodeLocal;
+    size_t queue_capacity = 4096;   // Preallocated Tasks per queue, the queues only grow past this
+};
 
 // Thread Pool Class to allow Threads per NUMA Node
 // Based on the Affinity of each node
 class ThreadPool {
 public:
-    ThreadPool(size_t num_threads, DWORD_PTR affinity_mask) {
+    ThreadPool(const Topology& topology, size_t node_index, const ThreadPoolOptions& options = {})
+        : mode(options.mode), steal_policy(options.steal_policy), tasks(options.mode == PoolMode::SharedQueue ? options.queue_capacity : 1) {
+        const CpuSet affinity = topology.get_nodes()[node_index].cpus;
+        const std::vector<size_t> node_cpus = affinity.cpus();
+        const size_t num_threads = options.num_threads ? options.num_threads : node_cpus.size();
+
+        thread_ids = std::make_unique<std::atomic<int64_t>[]>(num_threads);
+
+        if constexpr (Telemetry::ENABLED) {
+            for (size_t i = 0; i < num_threads; ++i)
+                telemetry.emplace_back(std::make_unique<Telemetry::WorkerTelemetry>());
+        }
+
+        if (mode == PoolMode::WorkStealing) {
+            // Each thread owns one CPU so the steal order can follow the cache hierarchy
+            for (size_t i = 0; i < num_threads; ++i) {
+                workers.emplace_back(std::make_unique<Worker>(options.queue_capacity));
+                workers.back()->cpu = node_cpus[i % node_cpus.size()];
+            }
+            build_steal_order(topology);
+        }
 
         // Create the threads one per Core in the Node
         for (size_t i = 0; i < num_threads; ++i) {
-            threads.emplace_back([this, affinity_mask, i]() {
+            if (mode == PoolMode::WorkStealing) {
+                threads.emplace_back([this, i]() {
+                    thread_ids[i].store(Platform::current_thread_id());
+                    attach_telemetry(i);
+                    CpuSet own_cpu;
+                    own_cpu.set(workers[i]->cpu);
+                    if (!Platform::pin_current_thread(own_cpu)) {
+                        std::cerr << "Error setting thread affinity mask!" << std::endl;
+                    }
+                    stealing_loop(i);
+                    });
+                continue;
+            }
+
+            threads.emplace_back([this, affinity, i]() {
+                thread_ids[i].store(Platform::current_thread_id());
+                attach_telemetry(i);
 
-                // Set the affinity mask for this thread - Any Core in the Node
-                HANDLE thread = GetCurrentThread();
-                SetThreadAffinityMask(thread, affinity_mask);
+                // Set the affinity for this thread - Any Core in the Node
+                if (!Platform::pin_current_thread(affinity)) {
+                    std::cerr << "Error setting thread affinity mask!" << std::endl;
+                }
 
                 // Thread Loop
                 while (true) {
                     // Get the next task
-                    std::function<void()> task;
+                    Task task;
                     {
                         // Lock the mutex
                         std::unique_lock<std::mutex> lock(mutex);
                         // Wait for a task if there are no tasks and the pool is not stopped
+                        const bool sleeping = tasks.empty() && !stop;
+                        const uint64_t idle_start = sleeping ? clock() : 0;
                         condition.wait(lock, [this] { return !tasks.empty() || stop; });
+                        if (sleeping)
+                            record_wakeup(idle_start);
                         // Exit the thread if the pool is stopped and there are no tasks
                         if (stop && tasks.empty()) return;
                         // Get the next task
-                        task = std::move(tasks.front());
-                        tasks.pop();
+                        task = tasks.pop_front();
                     }
-                    // Execute the Task
-                    task();
+                    // Execute the Task, release its captures before it counts as done
+                    execute(task);
+                    task.reset();
                     {
                         // Lock the mutex and decrement the number of tasks in progress and notify all if all tasks are done
                         std::unique_lock<std::mutex> lock(mutex);
@@ -54,12 +124,24 @@ public:
     }
 
     ~ThreadPool() {
+        shutdown();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Stop and join the threads, remaining tasks are run first
+    // Pools that steal from each other must all be shut down before any is destroyed
+    void shutdown() {
         {
             std::unique_lock<std::mutex> lock(mutex);
+            if (stop) return;
             stop = true;
         }
         // Notify all threads to stop
         condition.notify_all();
+        work_epoch.fetch_add(1);
+        work_epoch.notify_all();
         // Wait for all threads to finish
         for (std::thread& thread : threads) {
             thread.join();
@@ -69,31 +151,478 @@ public:
     // Enqueue a task
     template <class F>
     void enqueue(F&& f) {
+        if (mode == PoolMode::WorkStealing) {
+            Worker* own = current_worker();
+            if (own) {
+                // Spawned from one of our threads, keep it hot in that thread's deque
+                own->submitted.store(own->submitted.load(std::memory_order_relaxed) + 1);
+                std::lock_guard<std::mutex> lock(own->lock);
+                stamp(own->tasks.emplace_back(std::forward<F>(f)), clock());
+            }
+            else {
+                // From outside, spread round robin over the deques
+                Worker& target = *workers[next_worker.fetch_add(1, std::memory_order_relaxed) % workers.size()];
+                external_submitted.fetch_add(1);
+                std::lock_guard<std::mutex> lock(target.lock);
+                stamp(target.tasks.emplace_back(std::forward<F>(f)), clock());
+            }
+            wake_one();
+            return;
+        }
+
         {
             // Lock the mutex and increment the number of tasks in progress and add the task to the queue
             std::unique_lock<std::mutex> lock(mutex);
-            tasks.emplace(std::forward<F>(f));
+            stamp(tasks.emplace_back(std::forward<F>(f)), clock());
             ++tasks_in_progress;
         }
+        mark_wake();
         condition.notify_one();
     }
 
+    // Awaitable that resumes the coroutine on one of this pool's threads: co_await pool.schedule()
+    // The resume is an ordinary Task, so wait_for_all and the telemetry see it like any other
+    struct ScheduleAwaiter {
+        ThreadPool* pool;
+
+        bool await_ready() const noexcept {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+            pool->enqueue([handle]() { handle.resume(); });
+        }
+
+        void await_resume() const noexcept {
+        }
+    };
+
+    ScheduleAwaiter schedule() {
+        return ScheduleAwaiter{ this };
+    }
+
+    // Enqueue a batch of tasks with a single synchronization and wake only as many threads as there are tasks
+    // publish may take the tasks out of order, so anything short of random access is gathered in one pass first
+    template <class Iterator>
+    void enqueue_bulk(Iterator first, Iterator last) {
+        if constexpr (std::random_access_iterator<Iterator>) {
+            const size_t count = static_cast<size_t>(last - first);
+            publish(count, [&first](size_t index) { return Task(std::move(first[index])); });
+        }
+        else {
+            std::vector<Task> batch;
+            for (; first != last; ++first)
+                batch.emplace_back(std::move(*first));
+            publish(batch.size(), [&batch](size_t index) { return std::move(batch[index]); });
+        }
+    }
+
+    // Run body(i) for every i in [begin, end) and return without waiting, use wait_for_all to finish
+    // The range is published once as a shared job, each woken thread claims grain indices at a time
+    // until it runs out, so the submission cost does not grow with the size of the range
+    // The job itself is the one heap allocation per call
+    template <class F>
+    void parallel_for(size_t begin, size_t end, size_t grain, F&& body) {
+        if (begin >= end)
+            return;
+        grain = std::max<size_t>(grain, 1);
+
+        struct RangeJob {
+            RangeJob(size_t begin, size_t end, size_t grain, F&& body)
+                : next(begin), end(end), grain(grain), published(clock()), body(std::forward<F>(body)) {
+            }
+            std::atomic<size_t> next;
+            size_t end;
+            size_t grain;
+            uint64_t published;     // For the item wait histogram
+            std::decay_t<F> body;
+        };
+        auto job = std::make_shared<RangeJob>(begin, end, grain, std::forward<F>(body));
+
+        const size_t chunks = (end - begin + grain - 1) / grain;
+        const size_t claimers = std::min(chunks, threads.size());
+        publish(claimers, [&job](size_t) {
+            return Task([job]() {
+                while (true) {
+                    size_t first = job->next.fetch_add(job->grain, std::memory_order_relaxed);
+                    if (first >= job->end)
+                        return;
+                    size_t last = std::min(first + job->grain, job->end);
+                    const uint64_t start = clock();
+                    for (size_t index = first; index < last; ++index)
+                        job->body(index);
+                    record_item(job->published, start);
+                }
+                });
+            });
+    }
+
     // Wait for all tasks to finish
     void wait_for_all() {
+        if (mode == PoolMode::WorkStealing) {
+            while (true) {
+                // Read the epoch first so an idle transition after the check is not missed
+                uint32_t epoch = idle_epoch.load();
+                if (all_done())
+                    return;
+                idle_epoch.wait(epoch);
+            }
+        }
+
         std::unique_lock<std::mutex> lock(mutex);
         // Wait for all tasks to finish by waiting for the number of tasks in progress to be 0
         all_tasks_done.wait(lock, [this] { return tasks_in_progress == 0; });
     }
 
+    // Pools on the other Nodes, nearest first, used when the StealPolicy is AllowRemote
+    // Set before any work is submitted
+    void set_remote_pools(const std::vector<ThreadPool*>& pools) {
+        remote_pools = pools;
+    }
+
+    // Tasks submitted and not finished yet, queued or running, a snapshot that may be stale by the time it is used
+    // A parallel_for counts as one Task per thread it woke
+    size_t get_pending() {
+        if (mode == PoolMode::WorkStealing) {
+            size_t completed = remote_completed.load(std::memory_order_relaxed);
+            size_t submitted = external_submitted.load(std::memory_order_relaxed);
+            for (const auto& worker : workers) {
+                completed += worker->completed.load(std::memory_order_relaxed);
+                submitted += worker->submitted.load(std::memory_order_relaxed);
+            }
+            return submitted > completed ? submitted - completed : 0;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        return tasks_in_progress;
+    }
+
+    size_t get_num_threads() const {
+        return threads.size();
+    }
+
+    PoolMode get_mode() const {
+        return mode;
+    }
+
+    // OS thread ids of the pool threads, in thread order, waits for any thread that has not started yet
+    std::vector<int64_t> get_thread_ids() const {
+        std::vector<int64_t> ids;
+        for (size_t i = 0; i < threads.size(); ++i) {
+            while (thread_ids[i].load() == 0)
+                std::this_thread::yield();
+            ids.push_back(thread_ids[i].load());
+        }
+        return ids;
+    }
+
+    // Counters and histograms of every thread, safe to call while the pool is busy
+    // Empty when built without telemetry
+    Telemetry::PoolSnapshot get_telemetry() const {
+        Telemetry::PoolSnapshot snapshot;
+        for (const auto& worker : telemetry)
+            snapshot.workers.push_back(worker->snapshot());
+        return snapshot;
+    }
+
 private:
+    // Per thread state for WorkStealing, one cache line each so the owners do not false share
+    struct alignas(CACHE_LINE_SIZE) Worker {
+        explicit Worker(size_t queue_capacity) : tasks(queue_capacity) {
+        }
+        std::mutex lock;
+        TaskRing tasks;                                 // Owner pushes and pops the back, thieves take the front
+        std::vector<Worker*> victims;                   // Same Node threads, SMT siblings then same L3 then the rest
+        size_t cpu = 0;
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> submitted{ 0 };  // Only written by the owner
+        std::atomic<size_t> completed{ 0 };                           // Only written by the owner
+    };
+
+    struct WorkerContext {
+        ThreadPool* pool = nullptr;
+        Worker* worker = nullptr;
+    };
+
+    PoolMode mode;
+    StealPolicy steal_policy;
     std::vector<std::thread> threads;
-    std::queue<std::function<void()>> tasks;
+    TaskRing tasks;
     std::mutex mutex;
     std::condition_variable condition;
     std::condition_variable all_tasks_done;
     bool stop = false;
     size_t tasks_in_progress = 0;
+
+    // WorkStealing state
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<ThreadPool*> remote_pools;
+    std::atomic<size_t> next_worker{ 0 };
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> external_submitted{ 0 };
+    std::atomic<size_t> remote_completed{ 0 };                   // Our tasks run by another pool's threads
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> work_epoch{ 0 };  // Bumped when work arrives
+    std::atomic<uint32_t> sleepers{ 0 };
+    std::atomic<uint64_t> last_wake_ns{ 0 };                     // Telemetry: when work was last published
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> idle_epoch{ 0 };  // Bumped when a thread runs dry
+
+    std::unique_ptr<std::atomic<int64_t>[]> thread_ids;         // Set by each thread as it starts
+
+    // One per thread, indexed like threads, empty without telemetry
+    std::vector<std::unique_ptr<Telemetry::WorkerTelemetry>> telemetry;
+
+    // Telemetry time, 0 and no clock read without telemetry
+    static uint64_t clock() {
+        if constexpr (Telemetry::ENABLED)
+            return Telemetry::now_ns();
+        else
+            return 0;
+    }
+
+    static void stamp(Task& task, uint64_t now) {
+        if constexpr (Telemetry::ENABLED)
+            task.set_enqueue_time(now);
+    }
+
+    void attach_telemetry(size_t index) {
+        if constexpr (Telemetry::ENABLED)
+            Telemetry::current() = telemetry[index].get();
+    }
+
+    // Work was published, sleepers woken from here on measure their wakeup latency against it
+    void mark_wake() {
+        if constexpr (Telemetry::ENABLED)
+            last_wake_ns.store(Telemetry::now_ns(), std::memory_order_relaxed);
+    }
+
+    // Run a Task on a pool thread, recording queue wait and run time against that thread
+    static void execute(Task& task) {
+        if constexpr (Telemetry::ENABLED) {
+            Telemetry::WorkerTelemetry* record = Telemetry::current();
+            const uint64_t start = Telemetry::now_ns();
+            task();
+            if (record) {
+                const uint64_t end = Telemetry::now_ns();
+                const uint64_t enqueued = task.get_enqueue_time();
+                record->queue_wait.record(enqueued && start > enqueued ? start - enqueued : 0);
+                record->run_time.record(end - start);
+                Telemetry::bump(record->busy_ns, end - start);
+                Telemetry::bump(record->tasks);
+            }
+        }
+        else {
+            task();
+        }
+    }
+
+    // One parallel_for chunk finished on this thread
+    static void record_item(uint64_t published, uint64_t start) {
+        if constexpr (Telemetry::ENABLED) {
+            if (Telemetry::WorkerTelemetry* record = Telemetry::current()) {
+                record->item_wait.record(start > published ? start - published : 0);
+                record->item_run.record(Telemetry::now_ns() - start);
+                Telemetry::bump(record->items);
+            }
+        }
+    }
+
+    // The thread slept from idle_start until now
+    void record_wakeup(uint64_t idle_start) {
+        if constexpr (Telemetry::ENABLED) {
+            if (Telemetry::WorkerTelemetry* record = Telemetry::current()) {
+                const uint64_t now = Telemetry::now_ns();
+                Telemetry::bump(record->idle_ns, now - idle_start);
+                Telemetry::bump(record->wakeups);
+                const uint64_t woken = last_wake_ns.load(std::memory_order_relaxed);
+                if (woken >= idle_start && now >= woken)
+                    record->wakeup.record(now - woken);
+            }
+        }
+    }
+
+    static void count_steal(std::atomic<uint64_t> Telemetry::WorkerTelemetry::* counter) {
+        if constexpr (Telemetry::ENABLED) {
+            if (Telemetry::WorkerTelemetry* record = Telemetry::current())
+                Telemetry::bump(record->*counter);
+        }
+    }
+
+    static WorkerContext& context() {
+        static thread_local WorkerContext ctx;
+        return ctx;
+    }
+
+    // The calling thread's Worker if it belongs to this pool
+    Worker* current_worker() {
+        WorkerContext& ctx = context();
+        return ctx.pool == this ? ctx.worker : nullptr;
+    }
+
+    // Order every thread's victims: SMT siblings, then shared L3, then the rest of the Node
+    // Starting the scan just after ourselves spreads the thieves over different victims
+    void build_steal_order(const Topology& topology) {
+        for (size_t i = 0; i < workers.size(); ++i) {
+            const CpuInfo* info = topology.cpu_info(workers[i]->cpu);
+            auto rank = [&](const Worker& other) {
+                if (info && info->smt_siblings.test(other.cpu)) return 0;
+                if (info && info->l3_siblings.test(other.cpu)) return 1;
+                return 2;
+            };
+            std::vector<Worker*> victims;
+            for (size_t step = 1; step < workers.size(); ++step)
+                victims.push_back(workers[(i + step) % workers.size()].get());
+            std::stable_sort(victims.begin(), victims.end(), [&](const Worker* a, const Worker* b) {
+                return rank(*a) < rank(*b);
+                });
+            workers[i]->victims = std::move(victims);
+        }
+    }
+
+    // Put count tasks, make(i) builds the i'th, on the queues with one lock per queue and wake that many threads
+    template <class Make>
+    void publish(size_t count, Make&& make) {
+        if (count == 0)
+            return;
+
+        if (mode == PoolMode::WorkStealing) {
+            // Deal the batch out over the deques, taking each deque's lock once
+            Worker* own = current_worker();
+            if (own)
+                own->submitted.store(own->submitted.load(std::memory_order_relaxed) + count);
+            else
+                external_submitted.fetch_add(count);
+
+            const size_t start = next_worker.fetch_add(count, std::memory_order_relaxed);
+            const size_t targets = std::min(count, workers.size());
+            const uint64_t now = clock();
+            for (size_t t = 0; t < targets; ++t) {
+                Worker& target = *workers[(start + t) % workers.size()];
+                std::lock_guard<std::mutex> lock(target.lock);
+                for (size_t i = t; i < count; i += targets)
+                    stamp(target.tasks.push_back(make(i)), now);
+            }
+            wake(targets);
+            return;
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            const uint64_t now = clock();
+            for (size_t i = 0; i < count; ++i)
+                stamp(tasks.push_back(make(i)), now);
+            tasks_in_progress += count;
+        }
+        mark_wake();
+        if (count >= threads.size())
+            condition.notify_all();
+        else
+            for (size_t i = 0; i < count; ++i)
+                condition.notify_one();
+    }
+
+    void wake_one() {
+        wake(1);
+    }
+
+    // One epoch bump for the whole batch, then wake at most one sleeper per new task
+    void wake(size_t count) {
+        mark_wake();
+        work_epoch.fetch_add(1);
+        size_t sleeping = sleepers.load();
+        for (size_t i = 0; i < std::min(count, sleeping); ++i)
+            work_epoch.notify_one();
+    }
+
+    void notify_idle() {
+        idle_epoch.fetch_add(1);
+        idle_epoch.notify_all();
+    }
+
+    // Sum completed before submitted: every spawn is counted before its parent completes,
+    // so equal totals mean nothing submitted so far is still pending
+    bool all_done() const {
+        size_t completed = remote_completed.load();
+        for (const auto& worker : workers)
+            completed += worker->completed.load();
+        size_t submitted = external_submitted.load();
+        for (const auto& worker : workers)
+            submitted += worker->submitted.load();
+        return completed >= submitted;
+    }
+
+    static bool pop_back(Worker& worker, Task& task) {
+        std::lock_guard<std::mutex> lock(worker.lock);
+        if (worker.tasks.empty()) return false;
+        task = worker.tasks.pop_back();
+        return true;
+    }
+
+    static bool steal_front(Worker& worker, Task& task) {
+        std::lock_guard<std::mutex> lock(worker.lock);
+        if (worker.tasks.empty()) return false;
+        task = worker.tasks.pop_front();
+        return true;
+    }
+
+    // Take the oldest Task of the first victim that has one
+    static bool steal_local(Worker& self, Task& task) {
+        for (Worker* victim : self.victims) {
+            if (steal_front(*victim, task)) {
+                count_steal(&Telemetry::WorkerTelemetry::steals);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Run one task from our deque, a local victim, or a remote pool, false if there was nothing anywhere
+    bool run_one(Worker& self) {
+        Task task;
+        if (pop_back(self, task) || steal_local(self, task)) {
+            execute(task);
+            task.reset();
+            self.completed.store(self.completed.load(std::memory_order_relaxed) + 1);
+            return true;
+        }
+
+        if (steal_policy == StealPolicy::AllowRemote) {
+            for (ThreadPool* remote : remote_pools) {
+                if (remote->mode != PoolMode::WorkStealing)
+                    continue;
+                for (const auto& victim : remote->workers) {
+                    if (steal_front(*victim, task)) {
+                        count_steal(&Telemetry::WorkerTelemetry::remote_steals);
+                        execute(task);
+                        task.reset();
+                        remote->remote_completed.fetch_add(1);
+                        remote->notify_idle();
+                        return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    void stealing_loop(size_t index) {
+        Worker& self = *workers[index];
+        context() = { this, &self };
+
+        while (true) {
+            uint32_t epoch = work_epoch.load();
+            if (run_one(self))
+                continue;
+
+            // Nothing anywhere, let wait_for_all re-check before we sleep
+            notify_idle();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (stop) return;
+            }
+            sleepers.fetch_add(1);
+            const uint64_t idle_start = clock();
+            work_epoch.wait(epoch);
+            record_wakeup(idle_start);
+            sleepers.fetch_sub(1);
+        }
+    }
 };
 
 #endif // THREAD_POOL_H
-
@@ -0,0 +1,330 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "CpuSet.h"
+#include "Platform.h"
+
+// One NUMA Node as the OS reports it
+struct NodeInfo {
+    size_t id = 0;  // OS node number, may be sparse
+    CpuSet cpus;    // Logical CPUs local to the node
+};
+
+// Where a logical CPU sits in the machine
+struct CpuInfo {
+    size_t node_index = 0;  // Index into Topology::get_nodes(), not the OS node number
+    CpuSet smt_siblings;    // CPUs sharing the physical core, includes itself
+    CpuSet l3_siblings;     // CPUs sharing the last level cache, includes itself
+};
+
+// Machine layout: Nodes, their CPUs, SMT siblings, shared L3 domains and the Node distance matrix
+// Read from sysfs on Linux (the root can be overridden to load a fake machine) or from
+// GetLogicalProcessorInformationEx on Windows
+class Topology {
+public:
+    // Query the machine we are running on
+    static Topology discover() {
+#ifdef _WIN32
+        return from_windows();
+#else
+        return from_sysfs("/sys");
+#endif
+    }
+
+    // Load the topology from a sysfs style tree, e.g. "/sys" or a directory holding a fake 8 Node machine
+    // Any piece that is missing falls back to something sane: one Node, no SMT, one L3
+    static Topology from_sysfs(const std::string& sysfs_root) {
+        namespace fs = std::filesystem;
+        Topology topology;
+        const fs::path node_dir = fs::path(sysfs_root) / "devices/system/node";
+        const fs::path cpu_dir = fs::path(sysfs_root) / "devices/system/cpu";
+
+        // Nodes, sorted by OS id so the distance columns line up
+        std::error_code ec;
+        std::map<size_t, CpuSet> nodes;
+        for (const auto& entry : fs::directory_iterator(node_dir, ec)) {
+            const std::string name = entry.path().filename().string();
+            if (name.rfind("node", 0) != 0 || name.size() == 4 || !std::isdigit(static_cast<unsigned char>(name[4])))
+                continue;
+            CpuSet cpus = CpuSet::parse_list(read_file(entry.path() / "cpulist"));
+            // Memory only Nodes (no CPUs) can not run a ThreadPool, skip them
+            if (!cpus.empty())
+                nodes[std::stoul(name.substr(4))] = cpus;
+        }
+
+        if (nodes.empty()) {
+            CpuSet online = CpuSet::parse_list(read_file(cpu_dir / "online"));
+            if (online.empty()) {
+                for (size_t cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu)
+                    online.set(cpu);
+            }
+            nodes[0] = online;
+        }
+
+        for (const auto& [id, cpus] : nodes)
+            topology.nodes.push_back({ id, cpus });
+
+        // Distance matrix, each node lists its distance to every online node in id order
+        const size_t n = topology.nodes.size();
+        topology.distances.assign(n * n, REMOTE_DISTANCE);
+        std::vector<size_t> online_ids;
+        {
+            CpuSet online_nodes = CpuSet::parse_list(read_file(node_dir / "online"));
+            online_ids = online_nodes.empty() ? std::vector<size_t>{} : online_nodes.cpus();
+            if (online_ids.empty()) {
+                for (const auto& node : topology.nodes)
+                    online_ids.push_back(node.id);
+            }
+        }
+        for (size_t from = 0; from < n; ++from) {
+            std::istringstream row(read_file(node_dir / ("node" + std::to_string(topology.nodes[from].id)) / "distance"));
+            std::vector<int> values;
+            for (int value; row >> value; )
+                values.push_back(value);
+            for (size_t to = 0; to < n; ++to) {
+                auto column = std::find(online_ids.begin(), online_ids.end(), topology.nodes[to].id) - online_ids.begin();
+                if (static_cast<size_t>(column) < values.size())
+                    topology.distances[from * n + to] = values[column];
+                else
+                    topology.distances[from * n + to] = (from == to) ? LOCAL_DISTANCE : REMOTE_DISTANCE;
+            }
+        }
+
+        // Per CPU SMT and L3 domains
+        for (size_t index = 0; index < n; ++index) {
+            for (size_t cpu : topology.nodes[index].cpus.cpus()) {
+                const fs::path this_cpu = cpu_dir / ("cpu" + std::to_string(cpu));
+                CpuInfo info;
+                info.node_index = index;
+                info.smt_siblings = CpuSet::parse_list(read_file(this_cpu / "topology/thread_siblings_list"));
+                if (info.smt_siblings.empty())
+                    info.smt_siblings = CpuSet::parse_list(read_file(this_cpu / "topology/core_cpus_list"));
+                if (info.smt_siblings.empty())
+                    info.smt_siblings.set(cpu);
+
+                for (const auto& cache : fs::directory_iterator(this_cpu / "cache", ec)) {
+                    if (cache.path().filename().string().rfind("index", 0) != 0)
+                        continue;
+                    if (read_file(cache.path() / "level").rfind("3", 0) == 0)
+                        info.l3_siblings = CpuSet::parse_list(read_file(cache.path() / "shared_cpu_list"));
+                }
+                // No L3 information, assume the Node shares one
+                if (info.l3_siblings.empty())
+                    info.l3_siblings = topology.nodes[index].cpus;
+
+                topology.set_cpu(cpu, info);
+            }
+        }
+
+        return topology;
+    }
+
+#ifdef _WIN32
+    // Build the topology from the Windows processor information, CPUs are numbered group * 64 + bit
+    // Windows does not expose the SLIT, so distances are the ACPI defaults (10 local, 20 remote)
+    static Topology from_windows() {
+        Topology topology;
+        DWORD length = 0;
+        GetLogicalProcessorInformationEx(RelationAll, nullptr, &length);
+        std::vector<std::byte> data(length);
+        if (!GetLogicalProcessorInformationEx(RelationAll, reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(data.data()), &length)) {
+            std::cerr << "GetLogicalProcessorInformationEx failed, assuming one Node" << std::endl;
+            CpuSet all;
+            for (size_t cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu)
+                all.set(cpu);
+            topology.nodes.push_back({ 0, all });
+            topology.distances.assign(1, LOCAL_DISTANCE);
+            for (size_t cpu : all.cpus()) {
+                CpuInfo info;
+                info.smt_siblings.set(cpu);
+                info.l3_siblings = all;
+                topology.set_cpu(cpu, info);
+            }
+            return topology;
+        }
+
+        auto to_set = [](const GROUP_AFFINITY& affinity) {
+            CpuSet set;
+            for (size_t bit = 0; bit < 64; ++bit) {
+                if (affinity.Mask & (KAFFINITY(1) << bit))
+                    set.set(static_cast<size_t>(affinity.Group) * 64 + bit);
+            }
+            return set;
+        };
+
+        std::map<size_t, CpuSet> nodes;
+        std::vector<CpuSet> cores;
+        std::vector<CpuSet> l3s;
+        for (DWORD offset = 0; offset < length; ) {
+            auto info = reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(data.data() + offset);
+            switch (info->Relationship) {
+            case RelationNumaNode:
+                nodes[info->NumaNode.NodeNumber] |= to_set(info->NumaNode.GroupMask);
+                break;
+            case RelationProcessorCore: {
+                CpuSet core;
+                for (WORD group = 0; group < info->Processor.GroupCount; ++group)
+                    core |= to_set(info->Processor.GroupMask[group]);
+                cores.push_back(core);
+                break;
+            }
+            case RelationCache:
+                if (info->Cache.Level == 3)
+                    l3s.push_back(to_set(info->Cache.GroupMask));
+                break;
+            default:
+                break;
+            }
+            offset += info->Size;
+        }
+
+        for (const auto& [id, cpus] : nodes) {
+            if (!cpus.empty())
+                topology.nodes.push_back({ id, cpus });
+        }
+
+        const size_t n = topology.nodes.size();
+        topology.distances.assign(n * n, REMOTE_DISTANCE);
+        for (size_t i = 0; i < n; ++i)
+            topology.distances[i * n + i] = LOCAL_DISTANCE;
+
+        for (size_t index = 0; index < n; ++index) {
+            for (size_t cpu : topology.nodes[index].cpus.cpus()) {
+                CpuInfo info;
+                info.node_index = index;
+                for (const auto& core : cores) {
+                    if (core.test(cpu))
+                        info.smt_siblings = core;
+                }
+                for (const auto& l3 : l3s) {
+                    if (l3.test(cpu))
+                        info.l3_siblings = l3;
+                }
+                if (info.smt_siblings.empty())
+                    info.smt_siblings.set(cpu);
+                if (info.l3_siblings.empty())
+                    info.l3_siblings = topology.nodes[index].cpus;
+                topology.set_cpu(cpu, info);
+            }
+        }
+
+        return topology;
+    }
+#endif
+
+    size_t num_nodes() const {
+        return nodes.size();
+    }
+
+    const std::vector<NodeInfo>& get_nodes() const {
+        return nodes;
+    }
+
+    // Firmware distance between two Nodes (by index), 10 is local
+    int distance(size_t from_index, size_t to_index) const {
+        return distances[from_index * nodes.size() + to_index];
+    }
+
+    // Other Nodes ordered nearest first, the Node itself is not included
+    std::vector<size_t> nodes_by_distance(size_t from_index) const {
+        std::vector<size_t> order;
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            if (i != from_index)
+                order.push_back(i);
+        }
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return distance(from_index, a) < distance(from_index, b);
+            });
+        return order;
+    }
+
+    // Information for a logical CPU, nullptr if the CPU is not in any Node
+    const CpuInfo* cpu_info(size_t cpu) const {
+        return (cpu < cpus.size() && cpus[cpu].valid) ? &cpus[cpu].info : nullptr;
+    }
+
+    // Index of the Node owning a logical CPU, 0 if unknown
+    size_t node_of_cpu(size_t cpu) const {
+        const CpuInfo* info = cpu_info(cpu);
+        return info ? info->node_index : 0;
+    }
+
+    // Total number of logical CPUs across all Nodes
+    size_t num_cpus() const {
+        size_t total = 0;
+        for (const auto& node : nodes)
+            total += node.cpus.count();
+        return total;
+    }
+
+    // Human readable dump, used by --topology
+    void print(std::ostream& os) const {
+        os << "Nodes: " << nodes.size() << " CPUs: " << num_cpus() << "\n";
+        for (size_t index = 0; index < nodes.size(); ++index) {
+            const auto& node = nodes[index];
+            std::vector<CpuSet> cores;
+            std::vector<CpuSet> l3s;
+            for (size_t cpu : node.cpus.cpus()) {
+                const CpuInfo* info = cpu_info(cpu);
+                if (std::find(cores.begin(), cores.end(), info->smt_siblings) == cores.end())
+                    cores.push_back(info->smt_siblings);
+                if (std::find(l3s.begin(), l3s.end(), info->l3_siblings) == l3s.end())
+                    l3s.push_back(info->l3_siblings);
+            }
+            os << "Node " << node.id << ": CPUs " << node.cpus << " (" << node.cpus.count() << " threads, "
+                << cores.size() << " cores, " << l3s.size() << " L3 domains)\n";
+            for (const auto& l3 : l3s)
+                os << "    L3: " << l3 << "\n";
+        }
+        os << "Distances:\n";
+        for (size_t from = 0; from < nodes.size(); ++from) {
+            os << "   ";
+            for (size_t to = 0; to < nodes.size(); ++to)
+                os << " " << distance(from, to);
+            os << "\n";
+        }
+    }
+
+    static constexpr int LOCAL_DISTANCE = 10;
+    static constexpr int REMOTE_DISTANCE = 20;
+
+private:
+    struct CpuSlot {
+        bool valid = false;
+        CpuInfo info;
+    };
+
+    std::vector<NodeInfo> nodes;
+    std::vector<int> distances;  // nodes.size() x nodes.size(), row major
+    std::vector<CpuSlot> cpus;   // Indexed by logical CPU id
+
+    void set_cpu(size_t cpu, const CpuInfo& info) {
+        if (cpu >= cpus.size())
+            cpus.resize(cpu + 1);
+        cpus[cpu].valid = true;
+        cpus[cpu].info = info;
+    }
+
+    // Whole file as a string, empty if it does not exist
+    static std::string read_file(const std::filesystem::path& path) {
+        std::ifstream file(path);
+        if (!file)
+            return {};
+        std::stringstream contents;
+        contents << file.rdbuf();
+        return contents.str();
+    }
+};
+
+#endif // TOPOLOGY_H
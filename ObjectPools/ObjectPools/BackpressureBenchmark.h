@@ -0,0 +1,77 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include "ObjectPool.h"
+#include "ObjectWithData.h"
+
+// A load spike: threadCount handlers each take requestsPerThread objects, hold them for up to maxHoldMicros
+// and give them back, first against an unbounded pool and then against one capped at maxObjects
+// that waits up to timeoutMillis per acquire; the bounded pool turns the spike into queueing and rejections
+inline void runBackpressureBenchmark(size_t threadCount = 32, size_t requestsPerThread = 200, size_t maxObjects = 8,
+    size_t maxHoldMicros = 2000, size_t timeoutMillis = 20) {
+    ObjectWithData::logLifetime = false;
+    std::cout << "Backpressure: " << threadCount << " threads x " << requestsPerThread << " requests, hold up to "
+        << maxHoldMicros << " us, bound " << maxObjects << " objects, timeout " << timeoutMillis << " ms" << std::endl;
+    std::cout << std::setw(10) << "Pool" << std::setw(10) << "Objects" << std::setw(10) << "Served" << std::setw(10) << "Waits"
+        << std::setw(12) << "Rejected" << std::setw(14) << "Mean wait ms" << std::setw(13) << "Max wait ms"
+        << std::setw(12) << "Max queue" << std::setw(10) << "Seconds" << std::endl;
+
+    for (bool bounded : { false, true }) {
+        ObjectPool<ObjectWithData> pool(0, bounded ? maxObjects : SIZE_MAX);
+        std::vector<size_t> served(threadCount);
+        std::vector<std::thread> threads;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t t = 0; t < threadCount; ++t) {
+            threads.emplace_back([&pool, &served, t, requestsPerThread, maxHoldMicros, timeoutMillis]() {
+                std::mt19937 gen(static_cast<unsigned>(t));
+                std::uniform_int_distribution<size_t> holdDis(1, maxHoldMicros);
+                for (size_t request = 0; request < requestsPerThread; ++request) {
+                    auto obj = pool.acquireFor(std::chrono::milliseconds(timeoutMillis));
+                    if (!obj)
+                        continue;
+                    obj->allocateBuffer(1024);
+                    std::this_thread::sleep_for(std::chrono::microseconds(holdDis(gen)));
+                    ++served[t];
+                }
+                });
+        }
+        for (auto& thread : threads)
+            thread.join();
+        std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - start;
+
+        size_t total = 0;
+        for (size_t count : served)
+            total += count;
+        const auto stats = pool.getStats();
+        const size_t servedWaits = stats.waits - stats.timeouts;
+        std::cout << std::setw(10) << (bounded ? "bounded" : "unbounded") << std::setw(10) << pool.size()
+            << std::setw(10) << total << std::setw(10) << stats.waits << std::setw(12) << stats.rejections
+            << std::fixed << std::setprecision(3) << std::setw(14) << (servedWaits ? stats.totalWait / servedWaits * 1e3 : 0.0)
+            << std::setw(13) << stats.maxWait * 1e3 << std::setw(12) << stats.maxWaiters
+            << std::setprecision(2) << std::setw(10) << duration.count() << std::endl;
+    }
+
+    // The non blocking paths on a pool of one: tryAcquire while the object is out, then three futures in the queue,
+    // the middle one dropped, so its Handle goes straight back through the release and on to the last future
+    ObjectPool<ObjectWithData> pool(0, 1);
+    auto held = pool.acquire();
+    const bool refused = !pool.tryAcquire();
+    auto first = pool.acquireAsync();
+    pool.acquireAsync();
+    auto last = pool.acquireAsync();
+    held.reset();
+    auto firstObject = first.get();
+    const bool lastWaiting = last.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+    firstObject.reset();
+    const bool lastServed = last.wait_for(std::chrono::seconds(1)) == std::future_status::ready && last.get();
+    std::cout << "Pool of one: tryAcquire " << (refused ? "refused" : "served") << " while out, last future "
+        << (lastWaiting ? "waiting" : "ready") << " behind the dropped one, then " << (lastServed ? "served" : "not served")
+        << ", " << pool.active() << " out" << std::endl;
+}
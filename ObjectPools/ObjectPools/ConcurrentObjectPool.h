@@ -0,0 +1,226 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Concurrent drop-in for ObjectPool: same acquire / release, no lock on the hot path
+// Every thread keeps two magazines (small stacks of idle objects) per pool and only goes to the shared depot
+// to trade a whole magazine: a full one for an empty one on acquire, the other way round on release
+// The depot is two lock-free stacks of magazines, linked by index with an ABA tag next to the head index,
+// and magazines are never freed while the pool lives, so a stale pop can not read freed memory
+// A thread hoards at most 2 * magazineSize idle objects, the rest are in the depot for everyone
+template <typename T>
+class ConcurrentObjectPool {
+public:
+    using ObjectType = T;
+
+    // Objects per magazine, a thread trades with the depot at most once per this many acquires or releases
+    static constexpr uint32_t magazineSize = 32;
+
+    // Pre-allocate objects for the pool
+    explicit ConcurrentObjectPool(size_t poolSize) : shared(std::make_shared<Shared>()) {
+        static std::atomic<uint64_t> nextPoolId{ 1 };
+        shared->poolId = nextPoolId.fetch_add(1);
+
+        for (size_t i = 0; i < poolSize; i += magazineSize) {
+            uint32_t index = shared->allocateMagazine();
+            Magazine& magazine = shared->magazine(index);
+            while (magazine.count < magazineSize && i + magazine.count < poolSize)
+                magazine.objects[magazine.count++] = new ObjectType(++idCounter);
+            shared->fullMagazines.push(*shared, index);
+        }
+    }
+
+    ConcurrentObjectPool(const ConcurrentObjectPool&) = delete;
+    ConcurrentObjectPool& operator=(const ConcurrentObjectPool&) = delete;
+
+    // Idle objects go with the pool, including those still in other threads' magazines
+    // No thread may be using the pool while it is destroyed
+    ~ConcurrentObjectPool() {
+        const uint32_t count = shared->magazineCount.load();
+        for (uint32_t index = 0; index < count; ++index) {
+            Magazine& magazine = shared->magazine(index);
+            for (uint32_t i = 0; i < magazine.count; ++i)
+                delete magazine.objects[i];
+            magazine.count = 0;
+        }
+    }
+
+    // Acquire an object from the pool, a new one if the pool is dry
+    template <typename... Args>
+    std::unique_ptr<ObjectType> acquire(Args&&... args) {
+        ThreadCache& cache = threadCache();
+        Magazine* loaded = &shared->magazine(cache.loaded);
+        if (loaded->count == 0) {
+            if (shared->magazine(cache.previous).count > 0) {
+                std::swap(cache.loaded, cache.previous);
+            }
+            else {
+                // Both empty: trade the spare empty magazine for a full one
+                uint32_t full;
+                if (!shared->fullMagazines.pop(*shared, full))
+                    return std::make_unique<ObjectType>(++idCounter);
+                shared->emptyMagazines.push(*shared, cache.previous);
+                cache.previous = cache.loaded;
+                cache.loaded = full;
+            }
+            loaded = &shared->magazine(cache.loaded);
+        }
+        return std::unique_ptr<ObjectType>(loaded->objects[--loaded->count]);
+    }
+
+    // Release an object back to the pool
+    void release(std::unique_ptr<ObjectType> obj) {
+        if (!obj)
+            return;
+        ThreadCache& cache = threadCache();
+        Magazine* loaded = &shared->magazine(cache.loaded);
+        if (loaded->count == magazineSize) {
+            if (shared->magazine(cache.previous).count < magazineSize) {
+                std::swap(cache.loaded, cache.previous);
+            }
+            else {
+                // Both full: hand the spare full magazine to the depot and start an empty one
+                uint32_t empty;
+                if (!shared->emptyMagazines.pop(*shared, empty))
+                    empty = shared->allocateMagazine();
+                shared->fullMagazines.push(*shared, cache.previous);
+                cache.previous = cache.loaded;
+                cache.loaded = empty;
+            }
+            loaded = &shared->magazine(cache.loaded);
+        }
+        loaded->objects[loaded->count++] = obj.release();
+    }
+
+private:
+    static constexpr uint32_t emptyIndex = UINT32_MAX;
+    static constexpr uint32_t segmentBits = 6;              // 64 magazines per segment
+    static constexpr uint32_t maxSegments = 1u << 14;       // 1M magazines, 32M objects
+
+    struct Magazine {
+        std::atomic<uint32_t> next{ emptyIndex };   // Link in a depot stack
+        uint32_t count = 0;                         // Only the owning thread, or the depot, touches the objects
+        ObjectType* objects[magazineSize];
+    };
+
+    struct Shared;
+
+    // Treiber stack of magazine indices, the head packs the top index with a tag bumped on every change
+    struct MagazineStack {
+        alignas(64) std::atomic<uint64_t> head{ pack(emptyIndex, 0) };
+
+        static constexpr uint64_t pack(uint32_t index, uint32_t tag) {
+            return (static_cast<uint64_t>(tag) << 32) | index;
+        }
+
+        void push(Shared& owner, uint32_t index) {
+            uint64_t oldHead = head.load(std::memory_order_relaxed);
+            do {
+                owner.magazine(index).next.store(static_cast<uint32_t>(oldHead), std::memory_order_relaxed);
+            } while (!head.compare_exchange_weak(oldHead, pack(index, static_cast<uint32_t>(oldHead >> 32) + 1),
+                std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        bool pop(Shared& owner, uint32_t& index) {
+            uint64_t oldHead = head.load(std::memory_order_acquire);
+            while (true) {
+                index = static_cast<uint32_t>(oldHead);
+                if (index == emptyIndex)
+                    return false;
+                // The tag makes the CAS fail if the magazine was popped and pushed back in between
+                uint32_t next = owner.magazine(index).next.load(std::memory_order_relaxed);
+                if (head.compare_exchange_weak(oldHead, pack(next, static_cast<uint32_t>(oldHead >> 32) + 1),
+                    std::memory_order_acquire, std::memory_order_acquire))
+                    return true;
+            }
+        }
+    };
+
+    // Everything the thread caches point into, kept alive by them until their threads are done with it
+    struct Shared {
+        uint64_t poolId = 0;
+        MagazineStack fullMagazines;    // Magazines with objects in them, not always full when a thread exited
+        MagazineStack emptyMagazines;
+        std::atomic<uint32_t> magazineCount{ 0 };
+        std::unique_ptr<std::atomic<Magazine*>[]> segments = std::make_unique<std::atomic<Magazine*>[]>(maxSegments);
+        std::mutex growMutex;           // Only taken to make a new magazine, when the depot has no empty one
+
+        ~Shared() {
+            for (uint32_t i = 0; i < maxSegments && segments[i].load(); ++i)
+                delete[] segments[i].load();
+        }
+
+        Magazine& magazine(uint32_t index) {
+            return segments[index >> segmentBits].load(std::memory_order_acquire)[index & ((1u << segmentBits) - 1)];
+        }
+
+        // A new empty magazine, nobody else sees it until it is pushed onto a depot stack
+        uint32_t allocateMagazine() {
+            std::lock_guard<std::mutex> lock(growMutex);
+            const uint32_t index = magazineCount.load(std::memory_order_relaxed);
+            const uint32_t segment = index >> segmentBits;
+            if (segment >= maxSegments)
+                throw std::bad_alloc();
+            if (!segments[segment].load(std::memory_order_relaxed))
+                segments[segment].store(new Magazine[1u << segmentBits], std::memory_order_release);
+            magazineCount.store(index + 1, std::memory_order_release);
+            return index;
+        }
+    };
+
+    // A thread's two magazines for one pool
+    struct ThreadCache {
+        uint64_t poolId = 0;
+        std::weak_ptr<Shared> owner;
+        uint32_t loaded = emptyIndex;
+        uint32_t previous = emptyIndex;
+    };
+
+    // Hand the magazines back to the depot when the thread exits, if the pool is still alive
+    struct ThreadCaches {
+        std::vector<ThreadCache> caches;
+        ~ThreadCaches() {
+            for (auto& cache : caches) {
+                if (auto owner = cache.owner.lock()) {
+                    for (uint32_t index : { cache.loaded, cache.previous }) {
+                        if (owner->magazine(index).count > 0)
+                            owner->fullMagazines.push(*owner, index);
+                        else
+                            owner->emptyMagazines.push(*owner, index);
+                    }
+                }
+            }
+        }
+    };
+
+    std::shared_ptr<Shared> shared;
+    std::atomic<size_t> idCounter{ 0 };  // Counter to assign unique IDs to objects
+
+    // This thread's magazines for this pool, two empty ones on first use
+    ThreadCache& threadCache() {
+        static thread_local ThreadCaches threadCaches;
+        for (auto& entry : threadCaches.caches) {
+            if (entry.poolId == shared->poolId)
+                return entry;
+        }
+        // Forget caches of pools that have gone away before adding a new one
+        std::erase_if(threadCaches.caches, [](const ThreadCache& entry) { return entry.owner.expired(); });
+        ThreadCache entry;
+        entry.poolId = shared->poolId;
+        entry.owner = shared;
+        for (uint32_t* index : { &entry.loaded, &entry.previous }) {
+            if (!shared->emptyMagazines.pop(*shared, *index))
+                *index = shared->allocateMagazine();
+        }
+        threadCaches.caches.push_back(entry);
+        return threadCaches.caches.back();
+    }
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "ObjectPool.h"
+#include "ConcurrentObjectPool.h"
+
+// Small quiet object for the benchmarks, ObjectWithData logs every construction
+class BenchmarkObject {
+public:
+    explicit BenchmarkObject(size_t id) : id(id) {
+    }
+
+    size_t id = 0;
+    std::byte payload[56] = {};
+};
+
+// Every thread acquires heldPerThread objects, touches them and releases them, over and over
+// Returns millions of acquire + release pairs per second over all threads
+template <typename Pool>
+double runContention(size_t threadCount, size_t operationsPerThread, size_t heldPerThread) {
+    Pool pool(threadCount * heldPerThread);
+    std::atomic<size_t> ready{ 0 };
+    std::atomic<bool> go{ false };
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&pool, &ready, &go, operationsPerThread, heldPerThread]() {
+            std::vector<decltype(pool.acquire())> held(heldPerThread);
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+            for (size_t done = 0; done < operationsPerThread; done += heldPerThread) {
+                for (auto& obj : held) {
+                    obj = pool.acquire();
+                    obj->payload[0] = static_cast<std::byte>(done);
+                }
+                for (auto& obj : held)
+                    pool.release(std::move(obj));
+            }
+            });
+    }
+    while (ready.load() < threadCount)
+        std::this_thread::yield();
+    auto start = std::chrono::high_resolution_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& thread : threads)
+        thread.join();
+    std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - start;
+
+    // Round the per thread count up to whole batches, the way the threads ran them
+    const size_t operations = (operationsPerThread + heldPerThread - 1) / heldPerThread * heldPerThread;
+    return threadCount * operations / duration.count() / 1e6;
+}
+
+// Mutex ObjectPool against ConcurrentObjectPool from 1 to maxThreads threads
+inline void runContentionBenchmark(size_t maxThreads = 64, size_t operationsPerThread = 1000000, size_t heldPerThread = 4) {
+    std::cout << "Contention: " << operationsPerThread << " acquire + release per thread, " << heldPerThread
+        << " held at a time, " << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+    std::cout << std::setw(8) << "Threads" << std::setw(16) << "Mutex Mops/s" << std::setw(20) << "Concurrent Mops/s"
+        << std::setw(10) << "Speedup" << std::endl;
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        double locked = runContention<ObjectPool<BenchmarkObject>>(threads, operationsPerThread, heldPerThread);
+        double concurrent = runContention<ConcurrentObjectPool<BenchmarkObject>>(threads, operationsPerThread, heldPerThread);
+        std::cout << std::setw(8) << threads << std::fixed << std::setprecision(2) << std::setw(16) << locked
+            << std::setw(20) << concurrent << std::setw(9) << concurrent / locked << "x" << std::endl;
+    }
+}
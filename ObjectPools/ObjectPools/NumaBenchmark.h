@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "NumaObjectPool.h"
+#include "ObjectWithData.h"
+
+// Threads pinned to each Node in turn run acquire, fill and read the buffer, release, against their own Node's pool
+// (local) and against the farthest Node's pool (remote); the gap is what NumaObjectPool's local acquire saves
+// Big buffers get fewer operations, at most about 2 GB of buffer traffic per thread
+// A Node running out of memory (NodeMemoryExhausted) is rethrown from the calling thread
+inline void runNumaBenchmark(size_t bufferBytes = 4096, size_t operationsPerThread = 200000, size_t maxThreadsPerNode = 4) {
+    ObjectWithData::logLifetime = false;
+    Topology topology = Topology::discover();
+    const size_t heldPerThread = 4;
+    NumaObjectPool<ObjectWithData> pool(topology, maxThreadsPerNode * heldPerThread);
+    operationsPerThread = std::max(heldPerThread, std::min(operationsPerThread, (size_t{ 2 } << 30) / std::max<size_t>(bufferBytes, 1)));
+
+    std::cout << "NUMA pools: " << topology.num_nodes() << " Nodes, " << bufferBytes << " B buffers, "
+        << operationsPerThread << " acquire + release per thread" << std::endl;
+    if (topology.num_nodes() == 1)
+        std::cout << "Only one Node, remote is the same memory as local" << std::endl;
+    std::cout << std::setw(8) << "Node" << std::setw(8) << "Pool" << std::setw(10) << "Threads"
+        << std::setw(10) << "Mops/s" << std::setw(10) << "GB/s" << std::setw(10) << "Pool MB" << std::endl;
+
+    for (size_t node = 0; node < topology.num_nodes(); ++node) {
+        const NodeInfo& info = topology.get_nodes()[node];
+        const size_t threadCount = std::max<size_t>(1, std::min(maxThreadsPerNode, info.cpus.count()));
+        const size_t remote = topology.nodes_by_distance(node).empty() ? node : topology.nodes_by_distance(node).back();
+
+        for (size_t target : { node, remote }) {
+            std::atomic<size_t> ready{ 0 };
+            std::atomic<bool> go{ false };
+            std::atomic<uint64_t> checksum{ 0 };
+            std::exception_ptr error;
+            std::mutex errorMutex;
+            std::vector<std::thread> threads;
+            for (size_t t = 0; t < threadCount; ++t) {
+                threads.emplace_back([&, target]() {
+                    Platform::pin_current_thread(info.cpus);
+                    std::vector<NumaObjectPool<ObjectWithData>::Handle> held(heldPerThread);
+                    uint64_t sum = 0;
+                    ready.fetch_add(1);
+                    while (!go.load(std::memory_order_acquire))
+                        std::this_thread::yield();
+                    try {
+                        for (size_t done = 0; done < operationsPerThread; done += heldPerThread) {
+                            for (auto& obj : held) {
+                                obj = pool.acquireOn(target, bufferBytes);
+                                std::byte* buffer = obj->allocateBuffer(bufferBytes);
+                                std::memset(buffer, static_cast<int>(done & 0xFF), bufferBytes);
+                                for (size_t i = 0; i < bufferBytes; i += 64)
+                                    sum += static_cast<uint64_t>(buffer[i]);
+                            }
+                            for (auto& obj : held)
+                                obj.reset();
+                        }
+                    }
+                    catch (...) {
+                        std::lock_guard<std::mutex> lock(errorMutex);
+                        if (!error)
+                            error = std::current_exception();
+                    }
+                    checksum.fetch_add(sum);
+                    });
+            }
+            while (ready.load() < threadCount)
+                std::this_thread::yield();
+            auto start = std::chrono::high_resolution_clock::now();
+            go.store(true, std::memory_order_release);
+            for (auto& thread : threads)
+                thread.join();
+            std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - start;
+            if (error)
+                std::rethrow_exception(error);
+
+            const double operations = static_cast<double>(threadCount) * ((operationsPerThread + heldPerThread - 1) / heldPerThread * heldPerThread);
+            std::cout << std::setw(8) << node << std::setw(8) << target << std::setw(10) << threadCount << std::fixed << std::setprecision(2)
+                << std::setw(10) << operations / duration.count() / 1e6
+                << std::setw(10) << operations * bufferBytes / duration.count() / 1e9
+                << std::setw(10) << pool.getReservedBytes(target) / 1048576.0 << std::endl;
+        }
+    }
+}
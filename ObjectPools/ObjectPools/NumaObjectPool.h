@@ -0,0 +1,180 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "ObjectPool.h"
+#include "Platform.h"
+#include "Topology.h"
+
+// What a NumaObjectPool throws when a Node can not hand out more memory, what() names the Node
+class NodeMemoryExhausted : public std::bad_alloc {
+public:
+    NodeMemoryExhausted(size_t node, size_t bytes, size_t reserved, size_t limit) {
+        if (limit == SIZE_MAX)
+            std::snprintf(message, sizeof(message), "NUMA Node %zu out of memory: %zu more bytes refused by the OS with %zu reserved",
+                node, bytes, reserved);
+        else
+            std::snprintf(message, sizeof(message), "NUMA Node %zu out of memory: %zu more bytes would pass the %zu byte limit with %zu reserved",
+                node, bytes, limit, reserved);
+    }
+
+    const char* what() const noexcept override {
+        return message;
+    }
+
+private:
+    char message[160] = {};
+};
+
+// One ObjectPool per NUMA Node, each carving its slabs and its objects' buffers from memory bound to that Node
+// Each Node has a synchronized pmr pool over an upstream that maps Node bound memory from the OS as it is needed
+// and unmaps it when given back, so the pools grow with demand and buffers too big to pool are really freed
+// A thread that acquires from its own Node gets an object and a buffer in local memory
+// Handles go back to the Node pool they came from, wherever they are released
+template <typename T>
+class NumaObjectPool {
+public:
+    using ObjectType = T;
+    using Handle = typename ObjectPool<T>::Handle;
+
+    // Blocks up to this size are pooled and reused by the pmr pool, bigger ones go straight to the OS and back
+    // The pool asks upstream for chunks of about 16 blocks, so this also bounds what an idle size class can hold
+    static constexpr size_t largestPooledBlock = 64 * 1024;
+
+    // objectsPerNode are made up front on each Node, maxBytesPerNode caps the memory a Node maps for slabs and buffers
+    // Past the cap, or when the OS refuses, acquire throws NodeMemoryExhausted
+    NumaObjectPool(const Topology& topology, size_t objectsPerNode, size_t maxBytesPerNode = SIZE_MAX, size_t maxObjectsPerNode = SIZE_MAX)
+        : topology(topology) {
+        for (size_t node = 0; node < topology.num_nodes(); ++node)
+            arenas.push_back(std::make_unique<NodeArena>(node, topology.get_nodes()[node].id, maxBytesPerNode));
+        for (auto& arena : arenas)
+            pools.push_back(std::make_unique<ObjectPool<T>>(objectsPerNode, maxObjectsPerNode, &arena->pool));
+    }
+
+    NumaObjectPool(const NumaObjectPool&) = delete;
+    NumaObjectPool& operator=(const NumaObjectPool&) = delete;
+
+    // Acquire from the calling thread's Node
+    template <typename... Args>
+    Handle acquire(Args&&... args) {
+        return acquireOn(localNode(), std::forward<Args>(args)...);
+    }
+
+    // Acquire from the given Node (Topology index)
+    // A Node out of memory frees its idle objects' buffers and tries once more before NodeMemoryExhausted gets out
+    template <typename... Args>
+    Handle acquireOn(size_t node, Args&&... args) {
+        try {
+            return pools[node]->acquire(args...);
+        }
+        catch (const NodeMemoryExhausted&) {
+            if (pools[node]->trim() == 0)
+                throw;
+        }
+        return pools[node]->acquire(std::forward<Args>(args)...);
+    }
+
+    ObjectPool<T>& getPool(size_t node) {
+        return *pools[node];
+    }
+
+    // The Node's memory as a pmr resource, for other containers that should live next to the pool
+    std::pmr::memory_resource* getResource(size_t node) {
+        return &arenas[node]->pool;
+    }
+
+    // Bytes the Node has mapped from the OS right now, pooled blocks included
+    size_t getReservedBytes(size_t node) const {
+        return arenas[node]->upstream.reserved.load();
+    }
+
+    // Topology index of the Node the calling thread runs on
+    size_t localNode() const {
+        return topology.node_of_cpu(Platform::current_cpu());
+    }
+
+    size_t getNumNodes() const {
+        return pools.size();
+    }
+
+private:
+    // Maps every request from the OS bound to the Node and unmaps it on deallocate
+    // The pmr pool above asks for whole chunks, aligned to their block size, so only chunks and the blocks too big
+    // to pool come through here; alignments past the page are over mapped and each mapping is looked up on the way back
+    struct NodeUpstream : std::pmr::memory_resource {
+        NodeUpstream(size_t node, size_t osNode, size_t limit) : node(node), osNode(osNode), limit(limit) {
+        }
+
+        ~NodeUpstream() {
+            for (auto& [ptr, memory] : mappings)
+                Platform::free_on_node(memory);
+        }
+
+        size_t node;            // Topology index, for the error
+        size_t osNode;
+        size_t limit;
+        std::atomic<size_t> reserved{ 0 };
+        std::mutex mappingsMutex;
+        std::unordered_map<void*, Platform::NodeMemory> mappings;  // Pointer handed out -> its mapping
+
+        void* do_allocate(size_t bytes, size_t alignment) override {
+            const size_t page = Platform::page_size();
+            const size_t wanted = Platform::round_up(std::max<size_t>(bytes, 1), page) + (alignment > page ? alignment : 0);
+            const size_t before = reserved.fetch_add(wanted);
+            if (limit != SIZE_MAX && before + wanted > limit) {
+                reserved.fetch_sub(wanted);
+                throw NodeMemoryExhausted(node, wanted, before, limit);
+            }
+            Platform::NodeMemory memory;
+            try {
+                memory = Platform::allocate_on_node(wanted, osNode);
+            }
+            catch (const std::bad_alloc&) {
+                reserved.fetch_sub(wanted);
+                throw NodeMemoryExhausted(node, wanted, before, SIZE_MAX);
+            }
+            void* ptr = reinterpret_cast<void*>(Platform::round_up(reinterpret_cast<uintptr_t>(memory.ptr), std::max(alignment, page)));
+            std::lock_guard<std::mutex> lock(mappingsMutex);
+            mappings.emplace(ptr, memory);
+            return ptr;
+        }
+
+        void do_deallocate(void* ptr, size_t, size_t) override {
+            Platform::NodeMemory memory;
+            {
+                std::lock_guard<std::mutex> lock(mappingsMutex);
+                auto it = mappings.find(ptr);
+                memory = it->second;
+                mappings.erase(it);
+            }
+            Platform::free_on_node(memory);
+            reserved.fetch_sub(memory.bytes);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+    };
+
+    struct NodeArena {
+        NodeArena(size_t node, size_t osNode, size_t limit)
+            : upstream(node, osNode, limit), pool(std::pmr::pool_options{ 0, largestPooledBlock }, &upstream) {
+        }
+
+        NodeUpstream upstream;
+        std::pmr::synchronized_pool_resource pool;
+    };
+
+    const Topology& topology;
+    std::vector<std::unique_ptr<NodeArena>> arenas;         // Declared first so the pools go before their memory
+    std::vector<std::unique_ptr<ObjectPool<T>>> pools;
+};
@@ -1,43 +1,524 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <future>
 #include <memory>
-#include <vector>
+#include <memory_resource>
 #include <mutex>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
+// Pool of reusable objects, stored in contiguous cache line aligned slabs and handed out as RAII Handles
+// Idle objects are chained through an intrusive free list in their slots, so acquire / release never allocate
+// and an object keeps whatever it owns (buffers) between uses
+// When the pool is dry acquire adds a slab as big as the pool so far, objects in it are constructed on first use
+// Types with a buffer (bufferCapacity() and releaseBuffer()) are kept in power of two size classes by capacity,
+// acquireWithCapacity hands out the smallest idle buffer that fits and a retained limit bounds the idle buffer bytes,
+// freeing only buffers that have sat idle for a while so the ones in steady use are kept
+// With maxObjects the pool never holds more objects than that: once they are all out acquire waits (or times out,
+// or is rejected, or resolves a future later), waiters are served first come first served and a release hands
+// its object straight to the longest waiting one, a release with nobody waiting wakes nobody
+// Slabs come from a pmr memory_resource, and types constructible from (id, memory_resource*) get it for their own buffers
 template <typename T>
 class ObjectPool {
 public:
     using ObjectType = T;
 
-    // Pre-allocate objects for the pool
-    explicit ObjectPool(size_t poolSize) {
-        for (size_t i = 0; i < poolSize; ++i) {
-            pool.push_back(std::make_unique<ObjectType>(++idCounter));
+    class Handle;
+
+    // What waiting for objects has cost, wait times in seconds
+    struct Stats {
+        size_t acquires = 0;        // Acquire calls of every kind
+        size_t waits = 0;           // Had to wait for a release
+        size_t timeouts = 0;        // Gave up waiting, counted in rejections too
+        size_t rejections = 0;      // Came back without an object
+        size_t maxWaiters = 0;      // Longest the waiting queue got
+        double totalWait = 0.0;     // Over the waits that got an object
+        double maxWait = 0.0;
+    };
+
+    // Pre-allocate objects for the pool, at most maxObjects will ever exist, slabs come from resource
+    explicit ObjectPool(size_t poolSize, size_t maxObjects = SIZE_MAX, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : maxObjects(std::max<size_t>(1, maxObjects)), resource(resource) {
+        poolSize = std::min(poolSize, this->maxObjects);
+        if (poolSize > 0) {
+            addSlab(poolSize);
+            while (freshSlots() > 0)
+                pushFree(constructFresh());
         }
     }
 
-    // Acquire an object from the pool
-    template <typename... Args>
-    std::unique_ptr<ObjectType> acquire(Args&&... args) {
-        std::lock_guard<std::mutex> lock(poolMutex);
-        if (pool.empty()) {
-            return std::make_unique<ObjectType>(++idCounter);
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    // Every Handle must be gone before the pool, and nobody waiting in acquire; futures still waiting get broken_promise
+    ~ObjectPool() {
+        for (Waiter* waiter : waiters)
+            if (waiter->promise)    // Blocked acquires keep theirs on their own stack
+                delete waiter;
+        for (auto& slab : slabs) {
+            for (size_t i = 0; i < slab.constructed; ++i)
+                slab.slots[i].object()->~ObjectType();
+            resource->deallocate(slab.slots, slab.size * sizeof(Slot), alignof(Slot));
         }
-        else {
-            auto obj = std::move(pool.back());
-            pool.pop_back();
-            return obj;
+    }
+
+    // Acquire an object from the pool, args go to the object's reset hook (reset(args...)) before it is handed out
+    // Waits for a release when a bounded pool has every object out
+    template <typename... Args>
+    Handle acquire(Args&&... args) {
+        return handOut(take(0, Wait::Forever, {}), std::forward<Args>(args)...);
+    }
+
+    // Acquire without waiting, an empty Handle if a bounded pool has every object out
+    template <typename... Args>
+    Handle tryAcquire(Args&&... args) {
+        return handOut(take(0, Wait::Never, {}), std::forward<Args>(args)...);
+    }
+
+    // Acquire, waiting at most timeout for a release, an empty Handle if none came
+    template <typename Rep, typename Period, typename... Args>
+    Handle acquireFor(const std::chrono::duration<Rep, Period>& timeout, Args&&... args) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout);
+        return handOut(take(0, Wait::Until, deadline), std::forward<Args>(args)...);
+    }
+
+    // Future of an object, ready now if one is idle, otherwise when a release reaches this request in the queue
+    // The object is not reset, there is no caller thread to run the hook on
+    std::future<Handle> acquireAsync() {
+        std::unique_lock<std::mutex> lock(poolMutex);
+        ++stats.acquires;
+        std::promise<Handle> promise;
+        std::future<Handle> future = promise.get_future();
+        Slot* slot = waiters.empty() ? takeLocked(0) : nullptr;
+        if (slot) {
+            ++inUse;
+            promise.set_value(Handle(this, slot));
+            return future;
         }
+        Waiter* waiter = new Waiter;
+        waiter->promise.emplace(std::move(promise));
+        enqueueWaiter(waiter);
+        return future;
+    }
+
+    // Acquire an object whose buffer already holds bytes if an idle one does, smallest fitting size class first
+    // Otherwise the idle object with the least buffer, or a new one, whose buffer the caller grows
+    template <typename... Args>
+    Handle acquireWithCapacity(size_t bytes, Args&&... args) {
+        return handOut(take(classFor(bytes), Wait::Forever, {}), std::forward<Args>(args)...);
     }
 
-    // Release an object back to the pool
-    void release(std::unique_ptr<ObjectType> obj) {
+    // Cap on the buffer bytes idle objects hold: while over it, buffers idle for at least idleAge are freed,
+    // biggest first, so the buffers in steady use are never the ones to go
+    // Releases look at the clock every trimCheckInterval releases, a quiet pool needs trimIdle() from a timer
+    // Objects already idle when the limit is set count as idle for long enough
+    void setRetainedLimit(size_t bytes, std::chrono::steady_clock::duration idleAge = std::chrono::seconds(1)) {
         std::lock_guard<std::mutex> lock(poolMutex);
-        pool.push_back(std::move(obj));
+        retainedLimit = bytes;
+        maxIdleAge = idleAge;
+        trimIdleLocked(std::chrono::steady_clock::now());
+    }
+
+    // Apply the retained limit now, for a housekeeping timer when the pool may go quiet, returns the bytes freed
+    size_t trimIdle() {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        return trimIdleLocked(std::chrono::steady_clock::now());
+    }
+
+    // Free idle buffers, biggest first, until idle objects hold at most keepBytes, returns the bytes freed
+    size_t trim(size_t keepBytes = 0) {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        return trimTo(keepBytes);
+    }
+
+    // Buffer bytes held by idle objects
+    size_t retainedBytes() {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        return idleBytes;
+    }
+
+    // Release an object back to the pool, the same as letting the Handle go
+    void release(Handle obj) {
+        obj.reset();
+    }
+
+    // Where the slabs (and, for types that take it, the objects' buffers) come from
+    std::pmr::memory_resource* getResource() const {
+        return resource;
+    }
+
+    // Objects the pool has constructed
+    size_t size() {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        return constructedCount;
+    }
+
+    // Objects out in Handles right now
+    size_t active() {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        return inUse;
+    }
+
+    // Most objects the pool will hold, SIZE_MAX when unbounded
+    size_t maxSize() const {
+        return maxObjects;
+    }
+
+    Stats getStats() {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        return stats;
     }
 
 private:
-    std::vector<std::unique_ptr<ObjectType>> pool;  // Underlying container to hold pooled objects
+    static constexpr size_t minimumSlab = 16;
+    static constexpr size_t trimCheckInterval = 64;     // Releases per clock read under a retained limit
+
+    // Size class k > 0 holds buffers of at least classBase << (k - 1) bytes, class 0 those with less (or none)
+    static constexpr bool capacityAware = requires(ObjectType& obj) { obj.bufferCapacity(); obj.releaseBuffer(); };
+    static constexpr size_t sizeClasses = capacityAware ? 48 : 1;
+    static constexpr size_t classBase = 64;
+    static constexpr size_t slotAlignment = alignof(ObjectType) > 64 ? alignof(ObjectType) : 64;
+
+    // One object, on its own cache line(s), with the free list link next to it
+    struct alignas(slotAlignment) Slot {
+        alignas(ObjectType) unsigned char storage[sizeof(ObjectType)];
+        Slot* nextFree = nullptr;
+        uint64_t idleGeneration = 0;    // Pool generation at the last release, for the retained limit
+
+        ObjectType* object() {
+            return std::launder(reinterpret_cast<ObjectType*>(storage));
+        }
+    };
+
+    enum class Wait { Never, Until, Forever };
+
+    // One acquire waiting for a release: a blocked thread (on the stack) or a future (on the heap, deleted once served)
+    struct Waiter {
+        Slot* slot = nullptr;
+        std::condition_variable ready;
+        std::optional<std::promise<Handle>> promise;
+        std::chrono::steady_clock::time_point since;
+    };
+
+    struct Slab {
+        Slot* slots = nullptr;
+        size_t size = 0;
+        size_t constructed = 0;     // Slots [0, constructed) hold live objects
+    };
+
+    std::vector<Slab> slabs;
+    std::array<Slot*, sizeClasses> freeLists{};     // Idle objects per size class, most recently released first
+    uint64_t nonEmptyClasses = 0;                   // Bit k set when freeLists[k] has an object
+    size_t idleBytes = 0;                           // Buffer bytes held by idle objects
+    size_t retainedLimit = SIZE_MAX;
+    std::chrono::steady_clock::duration maxIdleAge{};
+    std::chrono::steady_clock::time_point nextGeneration;   // A generation lasts at least maxIdleAge / 2
+    uint64_t generation = 3;    // Unstamped objects (generation 0) are stale from the start
+    size_t releaseCount = 0;
+    size_t capacity = 0;        // Slots over all slabs
+    size_t constructedCount = 0;
+    size_t inUse = 0;
+    size_t maxObjects = SIZE_MAX;
+    std::pmr::memory_resource* resource;
+    std::deque<Waiter*> waiters;    // Oldest first
+    Stats stats;
     std::mutex poolMutex;  // Lock for thread safety
     size_t idCounter = 0;  // Counter to assign unique IDs to objects
-};
\ No newline at end of file
+
+    // Call obj.reset(args...) when the type has one, acquire() with no args works for any type
+    template <typename... Args>
+    static void resetObject(ObjectType& obj, Args&&... args) {
+        if constexpr (requires { obj.reset(std::forward<Args>(args)...); })
+            obj.reset(std::forward<Args>(args)...);
+        else
+            static_assert(sizeof...(Args) == 0, "acquire(args...) needs ObjectType::reset(args...)");
+    }
+
+    void addSlab(size_t count) {
+        Slab slab;
+        slab.slots = static_cast<Slot*>(resource->allocate(count * sizeof(Slot), alignof(Slot)));
+        std::uninitialized_default_construct_n(slab.slots, count);
+        slab.size = count;
+        slabs.push_back(slab);
+        capacity += count;
+    }
+
+    size_t freshSlots() const {
+        return slabs.empty() ? 0 : slabs.back().size - slabs.back().constructed;
+    }
+
+    Slot* constructFresh() {
+        Slab& slab = slabs.back();
+        Slot* slot = &slab.slots[slab.constructed];
+        if constexpr (std::is_constructible_v<ObjectType, size_t, std::pmr::memory_resource*>)
+            ::new (static_cast<void*>(slot->storage)) ObjectType(++idCounter, resource);
+        else
+            ::new (static_cast<void*>(slot->storage)) ObjectType(++idCounter);
+        ++slab.constructed;
+        ++constructedCount;
+        return slot;
+    }
+
+    static size_t bufferBytes(ObjectType& obj) {
+        if constexpr (capacityAware)
+            return obj.bufferCapacity();
+        else
+            return 0;
+    }
+
+    // Class an object with this much buffer goes in, every object in it has at least the class minimum
+    static size_t classOf(size_t bufferCapacity) {
+        if (sizeClasses == 1 || bufferCapacity < classBase)
+            return 0;
+        return std::min<size_t>(sizeClasses - 1, std::bit_width(bufferCapacity / classBase));
+    }
+
+    // Smallest class whose minimum is at least bytes
+    static size_t classFor(size_t bytes) {
+        if (sizeClasses == 1 || bytes == 0)
+            return 0;
+        if (bytes <= classBase)
+            return 1;
+        return std::min<size_t>(sizeClasses - 1, std::bit_width((bytes - 1) / classBase) + 1);
+    }
+
+    void pushFree(Slot* slot) {
+        const size_t bytes = bufferBytes(*slot->object());
+        const size_t sizeClass = classOf(bytes);
+        slot->nextFree = freeLists[sizeClass];
+        freeLists[sizeClass] = slot;
+        nonEmptyClasses |= uint64_t{ 1 } << sizeClass;
+        idleBytes += bytes;
+    }
+
+    Slot* popClass(size_t sizeClass) {
+        Slot* slot = freeLists[sizeClass];
+        freeLists[sizeClass] = slot->nextFree;
+        if (!freeLists[sizeClass])
+            nonEmptyClasses &= ~(uint64_t{ 1 } << sizeClass);
+        idleBytes -= bufferBytes(*slot->object());
+        return slot;
+    }
+
+    // The smallest class from fromClass up, else the smallest class there is, nullptr when nothing is idle
+    Slot* popFree(size_t fromClass = 0) {
+        if (!nonEmptyClasses)
+            return nullptr;
+        const uint64_t fitting = nonEmptyClasses & (~uint64_t{ 0 } << fromClass);
+        return popClass(static_cast<size_t>(std::countr_zero(fitting ? fitting : nonEmptyClasses)));
+    }
+
+    // Biggest idle buffers go first until idleBytes <= keepBytes, the objects stay idle without a buffer
+    size_t trimTo(size_t keepBytes) {
+        size_t freed = 0;
+        if constexpr (capacityAware) {
+            while (idleBytes > keepBytes && (nonEmptyClasses >> 1)) {
+                Slot* slot = popClass(static_cast<size_t>(std::bit_width(nonEmptyClasses) - 1));
+                freed += slot->object()->bufferCapacity();
+                slot->object()->releaseBuffer();
+                pushFree(slot);
+            }
+        }
+        return freed;
+    }
+
+    // Start a new generation once the current one is maxIdleAge / 2 old, then free the buffers released three
+    // generations ago or more, idle for at least maxIdleAge, biggest class first until idleBytes <= retainedLimit
+    // The free lists are most recently released first, so each class is walked to its stale tail
+    size_t trimIdleLocked(std::chrono::steady_clock::time_point now) {
+        size_t freed = 0;
+        if (now >= nextGeneration) {
+            ++generation;
+            nextGeneration = now + maxIdleAge / 2;
+        }
+        if constexpr (capacityAware) {
+            std::vector<Slot*> trimmed;
+            for (size_t sizeClass = sizeClasses; sizeClass-- > 1 && idleBytes > retainedLimit; ) {
+                Slot** link = &freeLists[sizeClass];
+                while (*link && idleBytes > retainedLimit) {
+                    Slot* slot = *link;
+                    if (slot->idleGeneration + 3 > generation) {
+                        link = &slot->nextFree;
+                        continue;
+                    }
+                    *link = slot->nextFree;
+                    const size_t bytes = slot->object()->bufferCapacity();
+                    idleBytes -= bytes;
+                    freed += bytes;
+                    slot->object()->releaseBuffer();
+                    trimmed.push_back(slot);
+                }
+                if (!freeLists[sizeClass])
+                    nonEmptyClasses &= ~(uint64_t{ 1 } << sizeClass);
+            }
+            for (Slot* slot : trimmed)
+                pushFree(slot);
+        }
+        return freed;
+    }
+
+    template <typename... Args>
+    Handle handOut(Slot* slot, Args&&... args) {
+        if (!slot)
+            return Handle();
+        // Owned before the hook runs, so a reset that throws (buffer allocation) still gives the object back
+        Handle handle(this, slot);
+        resetObject(*slot->object(), std::forward<Args>(args)...);
+        return handle;
+    }
+
+    // An idle object from fromClass up if there is one, else any idle object, else a new one if the bound allows
+    Slot* takeLocked(size_t fromClass) {
+        Slot* slot = popFree(fromClass);
+        if (!slot && constructedCount < maxObjects) {
+            if (freshSlots() == 0)
+                addSlab(std::min(std::max(minimumSlab, capacity), maxObjects - capacity));
+            slot = constructFresh();
+        }
+        return slot;
+    }
+
+    // Object for an acquire, waiting in line behind anyone already waiting so a release can not be taken out of turn
+    Slot* take(size_t fromClass, Wait wait, std::chrono::steady_clock::time_point deadline) {
+        std::unique_lock<std::mutex> lock(poolMutex);
+        ++stats.acquires;
+        Slot* slot = waiters.empty() ? takeLocked(fromClass) : nullptr;
+        if (slot) {
+            ++inUse;
+            return slot;
+        }
+        if (wait == Wait::Never) {
+            ++stats.rejections;
+            return nullptr;
+        }
+
+        Waiter waiter;
+        enqueueWaiter(&waiter);
+        while (!waiter.slot) {
+            if (wait == Wait::Forever) {
+                waiter.ready.wait(lock);
+            }
+            else if (waiter.ready.wait_until(lock, deadline) == std::cv_status::timeout && !waiter.slot) {
+                waiters.erase(std::find(waiters.begin(), waiters.end(), &waiter));
+                ++stats.timeouts;
+                ++stats.rejections;
+                return nullptr;
+            }
+        }
+        return waiter.slot;
+    }
+
+    void enqueueWaiter(Waiter* waiter) {
+        waiter->since = std::chrono::steady_clock::now();
+        waiters.push_back(waiter);
+        ++stats.waits;
+        stats.maxWaiters = std::max(stats.maxWaiters, waiters.size());
+    }
+
+    void giveBack(Slot* slot) {
+        std::unique_lock<std::mutex> lock(poolMutex);
+        if (!waiters.empty()) {
+            // Straight to the longest waiting acquire, the object stays out so inUse does not change
+            Waiter* waiter = waiters.front();
+            waiters.pop_front();
+            const double waited = std::chrono::duration<double>(std::chrono::steady_clock::now() - waiter->since).count();
+            stats.totalWait += waited;
+            stats.maxWait = std::max(stats.maxWait, waited);
+            if (waiter->promise) {
+                // Outside the lock: if the future was dropped the Handle comes straight back through here
+                std::unique_ptr<Waiter> served(waiter);
+                lock.unlock();
+                served->promise->set_value(Handle(this, slot));
+                return;
+            }
+            waiter->slot = slot;
+            waiter->ready.notify_one();
+            return;
+        }
+        if constexpr (capacityAware) {
+            if (retainedLimit != SIZE_MAX) {
+                // Stamped only under a limit, nothing else reads it
+                slot->idleGeneration = generation;
+                pushFree(slot);
+                --inUse;
+                if (++releaseCount % trimCheckInterval == 0)
+                    trimIdleLocked(std::chrono::steady_clock::now());
+                return;
+            }
+        }
+        pushFree(slot);
+        --inUse;
+    }
+
+public:
+    // Move-only owner of a pooled object, goes back to the pool when destroyed or reset
+    class Handle {
+    public:
+        Handle() = default;
+
+        Handle(Handle&& other) noexcept
+            : pool(std::exchange(other.pool, nullptr)), slot(std::exchange(other.slot, nullptr)) {
+        }
+
+        Handle& operator=(Handle&& other) noexcept {
+            if (this != &other) {
+                reset();
+                pool = std::exchange(other.pool, nullptr);
+                slot = std::exchange(other.slot, nullptr);
+            }
+            return *this;
+        }
+
+        Handle(const Handle&) = delete;
+        Handle& operator=(const Handle&) = delete;
+
+        ~Handle() {
+            reset();
+        }
+
+        explicit operator bool() const {
+            return slot != nullptr;
+        }
+
+        ObjectType* get() const {
+            return slot ? slot->object() : nullptr;
+        }
+
+        ObjectType* operator->() const {
+            return get();
+        }
+
+        ObjectType& operator*() const {
+            return *get();
+        }
+
+        // Give the object back now
+        void reset() {
+            if (slot) {
+                pool->giveBack(slot);
+                pool = nullptr;
+                slot = nullptr;
+            }
+        }
+
+    private:
+        friend class ObjectPool;
+
+        Handle(ObjectPool* pool, Slot* slot) : pool(pool), slot(slot) {
+        }
+
+        ObjectPool* pool = nullptr;
+        Slot* slot = nullptr;
+    };
+};
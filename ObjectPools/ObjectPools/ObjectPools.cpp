@@ -4,12 +4,48 @@
 #include <iostream>
 #include "ObjectPool.h"
 #include "ObjectWithData.h"
+#include "ContentionBenchmark.h"
+#include "ReuseBenchmark.h"
+#include "BackpressureBenchmark.h"
+#include "NumaBenchmark.h"
 #include <future>
 #include <random>
 #include <chrono>
 #include <thread>
-
-int main() {
+#include <string>
+
+int main(int argc, char* argv[]) {
+
+    // --contention [MAX_THREADS] compares the mutex pool with the ConcurrentObjectPool from 1 to 64 threads and exits
+    // --reuse compares plain acquire with acquire by buffer capacity over swinging payload sizes and exits
+    // --backpressure runs a load spike against an unbounded and a bounded pool and exits
+    // --numa [BUFFER_BYTES] compares NUMA Node local with remote pooled objects and exits
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--contention") {
+            size_t maxThreads = (i + 1 < argc) ? std::stoul(argv[i + 1]) : 64;
+            runContentionBenchmark(maxThreads);
+            return 0;
+        }
+        if (std::string(argv[i]) == "--reuse") {
+            runReuseBenchmark();
+            return 0;
+        }
+        if (std::string(argv[i]) == "--backpressure") {
+            runBackpressureBenchmark();
+            return 0;
+        }
+        if (std::string(argv[i]) == "--numa") {
+            size_t bufferBytes = (i + 1 < argc) ? std::stoul(argv[i + 1]) : 4096;
+            try {
+                runNumaBenchmark(bufferBytes);
+            }
+            catch (const std::bad_alloc& error) {
+                std::cerr << error.what() << std::endl;
+                return 1;
+            }
+            return 0;
+        }
+    }
 
     size_t totalObjects = 5;
     const size_t totalTests = 10;
@@ -29,7 +65,7 @@ int main() {
         std::cout << "Test: " << test << std::endl;
 
         // Vector to store futures that return the acquired objects
-        std::vector<std::future<std::unique_ptr<ObjectWithData>>> futures;
+        std::vector<std::future<ObjectPool<ObjectWithData>::Handle>> futures;
 
         // RePopulate the Pool Objects Buffers asynchronously
         for (auto i = 0; i < totalObjects; ++i) {
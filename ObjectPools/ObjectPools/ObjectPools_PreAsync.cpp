@@ -19,17 +19,15 @@ int main() {
         std::cout << "Test: " << test << std::endl;
 
         // Allocate the Objects Buffers
-        std::vector<std::unique_ptr<ObjectWithData>> objects;
+        std::vector<ObjectPool<ObjectWithData>::Handle> objects;
         for (auto i = 0; i < totalObjects; ++i) {
             auto obj = pool.acquire();
             obj->allocateBuffer(std::rand() % 1024);
             objects.push_back(std::move(obj));
         }
 
-        // Release the Objects back to the pool
-        for (auto& object : objects) {
-            pool.release(std::move(object));
-        }
+        // Release the Objects back to the pool, each Handle gives its object back when destroyed
+        objects.clear();
 
         // Increase the total objects by 2 - Grow the pool
         totalObjects *= 2;
@@ -1,27 +1,83 @@
+#pragma once
+
 #include <iostream>
 #include <memory>
 #include <vector>
 #include <cstdlib>
+#include <cstddef>
+#include <algorithm>
+#include <bit>
+#include <memory_resource>
 
 //  ObjectWithData class that has a Reusable buffer
 class ObjectWithData {
 public:
-    ObjectWithData( size_t id ) : id(id) {
-        std::cout << "ObjectWithData " << id << " created!" << std::endl;
+    // Smallest buffer, capacities are powers of two from here so they line up with ObjectPool's size classes
+    static constexpr size_t minimumCapacity = 64;
+
+    // Construction / destruction logging, the benchmarks turn it off
+    static inline bool logLifetime = true;
+
+    // The buffer comes from resource, a NUMA Node's arena in NumaObjectPool, the heap by default
+    ObjectWithData( size_t id, std::pmr::memory_resource* resource = std::pmr::get_default_resource() ) : id(id), resource(resource) {
+        if (logLifetime)
+            std::cout << "ObjectWithData " << id << " created!" << std::endl;
     }
 
     ~ObjectWithData() {
-        std::cout << "ObjectWithData " << id << " destroyed! buffer size: " << buffer.capacity() << " Active Size :" << buffer.size() << std::endl;
+        if (logLifetime)
+            std::cout << "ObjectWithData " << id << " destroyed! buffer size: " << capacity << " Active Size :" << size << std::endl;
+        releaseBuffer();
     }
 
+    ObjectWithData(const ObjectWithData&) = delete;
+    ObjectWithData& operator=(const ObjectWithData&) = delete;
+
+    // Buffer of at least size bytes, the old contents are not kept and new bytes are not zeroed
+    // Only reallocates when the buffer is too small, then to the next power of two
     std::byte* allocateBuffer(size_t size) {
 
         // Reallocate buffer if necessary
-        buffer.resize(size);
-        return buffer.data();
+        if (size > capacity) {
+            releaseBuffer();
+            const size_t grown = std::bit_ceil(std::max(size, minimumCapacity));
+            buffer = static_cast<std::byte*>(resource->allocate(grown, alignof(std::max_align_t)));
+            capacity = grown;
+            ++reallocations;
+        }
+        this->size = size;
+        return buffer;
+    }
+
+    // Pool reset hook: acquire(size) hands the object out with its buffer ready for size bytes
+    void reset(size_t size) {
+        allocateBuffer(size);
+    }
+
+    // Bytes the buffer can hold without reallocating
+    size_t bufferCapacity() const {
+        return capacity;
+    }
+
+    // Free the buffer, for pools trimming idle objects
+    void releaseBuffer() {
+        if (buffer)
+            resource->deallocate(buffer, capacity, alignof(std::max_align_t));
+        buffer = nullptr;
+        capacity = 0;
+        size = 0;
+    }
+
+    // Times allocateBuffer had to reallocate
+    size_t getReallocations() const {
+        return reallocations;
     }
 
 private:
-    std::vector<std::byte> buffer;
+    std::byte* buffer = nullptr;
+    size_t capacity = 0;
+    size_t size = 0;
+    size_t reallocations = 0;
     size_t id = 0;
-};
\ No newline at end of file
+    std::pmr::memory_resource* resource;
+};
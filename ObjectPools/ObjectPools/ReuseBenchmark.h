@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include "ObjectPool.h"
+#include "ObjectWithData.h"
+
+// Buffer churn with payloads from 64 B to 64 KB (log uniform, three orders of magnitude), one thread
+// Every round acquires 1 to maxHeld objects, sizes their buffers and releases them
+// Compares plain acquire with acquire by capacity, with and without a cap on the idle buffer bytes
+// The cap only frees buffers idle for idleAge, the objects past the usual round size, and keeps the busy ones
+inline void runReuseBenchmark(size_t rounds = 100000, size_t maxHeld = 64, size_t retainedLimit = 256 * 1024,
+    std::chrono::milliseconds idleAge = std::chrono::milliseconds(20)) {
+    ObjectWithData::logLifetime = false;
+    std::cout << "Buffer reuse: " << rounds << " rounds of 1 - " << maxHeld << " objects, 64 B - 64 KB payloads, limit "
+        << retainedLimit / 1024 << " KB after " << idleAge.count() << " ms idle" << std::endl;
+    std::cout << std::setw(26) << "Mode" << std::setw(14) << "Mops/s" << std::setw(16) << "Reallocations"
+        << std::setw(16) << "Retained KB" << std::setw(16) << "Idle later KB" << std::endl;
+
+    for (int mode = 0; mode < 3; ++mode) {
+        const bool byCapacity = mode > 0;
+        ObjectPool<ObjectWithData> pool(maxHeld);
+        if (mode == 2)
+            pool.setRetainedLimit(retainedLimit, idleAge);
+
+        std::mt19937 gen(12345);
+        std::uniform_real_distribution<> sizeDis(std::log(64.0), std::log(65536.0));
+        std::uniform_int_distribution<size_t> heldDis(1, maxHeld);
+        std::vector<ObjectPool<ObjectWithData>::Handle> held(maxHeld);
+        size_t reallocations = 0;
+        size_t operations = 0;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t round = 0; round < rounds; ++round) {
+            const size_t count = heldDis(gen);
+            for (size_t i = 0; i < count; ++i) {
+                const size_t size = static_cast<size_t>(std::exp(sizeDis(gen)));
+                held[i] = byCapacity ? pool.acquireWithCapacity(size) : pool.acquire();
+                const size_t before = held[i]->getReallocations();
+                held[i]->allocateBuffer(size)[0] = std::byte{ 1 };
+                reallocations += held[i]->getReallocations() - before;
+            }
+            for (size_t i = 0; i < count; ++i)
+                pool.release(std::move(held[i]));
+            operations += count;
+        }
+        std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - start;
+        const size_t retained = pool.retainedBytes();
+
+        // A housekeeping pass once everything has sat idle, only the capped pool lets go
+        for (int pass = 0; pass < 4; ++pass) {
+            std::this_thread::sleep_for(idleAge / 2);
+            pool.trimIdle();
+        }
+
+        const char* names[] = { "acquire", "acquireWithCapacity", "acquireWithCapacity+limit" };
+        std::cout << std::setw(26) << names[mode] << std::fixed << std::setprecision(2)
+            << std::setw(14) << operations / duration.count() / 1e6 << std::setw(16) << reallocations
+            << std::setw(16) << retained / 1024 << std::setw(16) << pool.retainedBytes() / 1024 << std::endl;
+    }
+}